@@ -0,0 +1,190 @@
+/*
+ * Host benchmark of the sketch: tags arrive on each reader after a script, the sketch runs
+ * on the simulated board and reports them on the LocoNet bus of wire_single.cpp.
+ *
+ * Reported: loop() passes per second, SPI transactions / chip select frames / bytes per
+ * pass, and the latency from the tag arrival to the start of its 0xE4 message on the bus.
+ *
+ * bench [-t seconds] [-p period ms] [-d dwell ms] [-n readers] [-u uid length] [-v]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <SPI.h>
+#include <MFRC522.h>
+#include <LocoNet.h>
+#include "hostsim.h"
+#include "wire_single.h"
+#include "../rfid2ln.h"
+
+extern void setup(void);
+extern void loop(void);
+
+#define BENCH_START_US   300000   /* boot done; the counters start here*/
+#define BENCH_TAGS_MAX   4096
+
+typedef struct {
+   uint8_t  rdr;
+   uint8_t  uid[HOST_UID_MAX];
+   uint8_t  len;
+   uint64_t us;
+   boolean  bReported;
+} __arrivalType;
+
+static __arrivalType arrivals[BENCH_TAGS_MAX];
+static uint32_t arrivalsNr = 0;
+
+static void tagHook(uint8_t rdr, const uint8_t *pUid, uint8_t len, bool bEnter){
+   if (bEnter && (arrivalsNr < BENCH_TAGS_MAX)) {
+      __arrivalType *a = &arrivals[arrivalsNr++];
+      a->rdr = rdr;
+      memcpy(a->uid, pUid, len);
+      a->len = len;
+      a->us = hostUs();
+      a->bReported = false;
+   }
+}
+
+static int cmpU64(const void *a, const void *b){
+   uint64_t x = *(const uint64_t *)a;
+   uint64_t y = *(const uint64_t *)b;
+   return (x > y) - (x < y);
+}
+
+/* the reader of the 0xE4 message; 0xFF if not a reader of this board*/
+static uint8_t e4Reader(const lnMsg *pMsg){
+   uint16_t addr = ((uint16_t)pMsg->data[3] << 7) | pMsg->data[4];
+
+   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+      if (rfidPorts[i].addrSenFull == addr) {
+         return i;
+      }
+   }
+   return 0xFF;
+}
+
+int main(int argc, char **argv){
+   uint32_t seconds = 10;
+   uint32_t periodMs = 500;
+   uint32_t dwellMs = 200;
+   uint8_t readers = NR_OF_RFID_PORTS;
+   uint8_t uidLen = 7;
+   const uint8_t ssPins[] = RFID_SS_PINS;
+#if USE_INTERRUPTS
+   const uint8_t irqPins[] = RFID_IRQ_PINS;
+#endif
+   int opt;
+
+   while ((opt = getopt(argc, argv, "t:p:d:n:u:v")) != -1) {
+      switch (opt) {
+         case 't': seconds = atoi(optarg); break;
+         case 'p': periodMs = atoi(optarg); break;
+         case 'd': dwellMs = atoi(optarg); break;
+         case 'n': readers = atoi(optarg); break;
+         case 'u': uidLen = atoi(optarg); break;
+         case 'v': hostSerialEcho = true; break;
+         default:
+            fprintf(stderr, "usage: %s [-t seconds] [-p period ms] [-d dwell ms] [-n readers] [-u 4|7|10] [-v]\n", argv[0]);
+            return 2;
+      }
+   }
+   if ((readers == 0) || (readers > NR_OF_RFID_PORTS) || ((uidLen != 4) && (uidLen != 7) && (uidLen != 10)) ||
+       (dwellMs >= periodMs)) {
+      fprintf(stderr, "bench: bad arguments\n");
+      return 2;
+   }
+
+   hostSeed(1);
+   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+#if USE_INTERRUPTS
+      hostReaderAdd(ssPins[i], irqPins[i], RST_PIN);
+#else
+      hostReaderAdd(ssPins[i], 0xFF, RST_PIN);
+#endif
+      hostReaderPlug(i, i < readers);
+   }
+
+   /* one tag per period on each reader, the readers shifted by a part of the period*/
+   uint64_t endUs = BENCH_START_US + (uint64_t)seconds * 1000000;
+   uint32_t seq = 0;
+   for (uint8_t r = 0; r < readers; r++) {
+      for (uint64_t t = BENCH_START_US + 100000 + (uint64_t)r * periodMs * 1000 / readers;
+           t + dwellMs * 1000 < endUs; t += (uint64_t)periodMs * 1000) {
+         uint8_t uid[HOST_UID_MAX];
+         seq++;
+         uid[0] = 0x04; //NXP
+         for (uint8_t i = 1; i < uidLen; i++) {
+            uid[i] = (uint8_t)((seq * 0x9E3779B1UL) >> (i * 3)) ^ (uint8_t)(i * 0x35);
+         }
+         uid[1] = (uint8_t)seq; //unique among the tags of the run
+         uid[2] = (uint8_t)(seq >> 8) | 0x80;
+         hostTagSchedule(t, r, uid, uidLen, true);
+         hostTagSchedule(t + dwellMs * 1000, r, uid, uidLen, false);
+      }
+   }
+   hostTagHook = tagHook;
+
+   setup();
+   while (hostUs() < BENCH_START_US) {
+      hostAdvanceUs(HOST_LOOP_US);
+      loop();
+   }
+   __hostCntType cnt0 = hostCnt;
+   uint64_t startUs = hostUs();
+   uint32_t passes = 0;
+   while (hostUs() < endUs) {
+      hostAdvanceUs(HOST_LOOP_US);
+      loop();
+      passes++;
+   }
+   double runS = (hostUs() - startUs) / 1e6;
+
+   /* the first 0xE4 of each arrival with the same UID, sent after the arrival*/
+   static uint64_t lat[BENCH_TAGS_MAX];
+   uint32_t latNr = 0;
+   for (uint32_t m = 0; m < hostLnLogNr; m++) {
+      const lnMsg *pMsg = &hostLnLog[m].msg;
+      if ((pMsg->data[0] != 0xE4) || (pMsg->data[2] != 0x41)) {
+         continue;
+      }
+      uint8_t rdr = e4Reader(pMsg);
+      uint8_t uid[UID_LEN];
+      for (uint8_t i = 0; i < UID_LEN; i++) {
+         uid[i] = pMsg->data[5 + i] | (((pMsg->data[5 + UID_LEN] >> i) & 0x01) << 7);
+      }
+      for (uint32_t a = 0; a < arrivalsNr; a++) {
+         __arrivalType *pArr = &arrivals[a];
+         uint8_t cmpLen = (pArr->len < UID_LEN) ? pArr->len : UID_LEN;
+         if (!pArr->bReported && (pArr->rdr == rdr) && (pArr->us <= hostLnLog[m].startUs) &&
+             (memcmp(pArr->uid, uid, cmpLen) == 0)) {
+            pArr->bReported = true;
+            lat[latNr++] = hostLnLog[m].startUs - pArr->us;
+            break;
+         }
+      }
+   }
+
+   printf("rfid2ln host benchmark: %s, %u of %u readers, %u byte UIDs\n",
+          USE_INTERRUPTS ? "interrupts" : "polling", readers, NR_OF_RFID_PORTS, uidLen);
+   printf("  %.2f s simulated, one tag per reader every %u ms, %u ms in the field\n", runS, periodMs, dwellMs);
+   printf("  loop(): %u passes, %.0f passes/s\n", passes, passes / runS);
+   printf("  SPI per pass: %.2f transactions, %.2f chip select frames, %.1f bytes\n",
+          (double)(hostCnt.spiTrans - cnt0.spiTrans) / passes, (double)(hostCnt.spiFrames - cnt0.spiFrames) / passes,
+          (double)(hostCnt.spiBytes - cnt0.spiBytes) / passes);
+#if USE_INTERRUPTS
+   printf("  reader interrupts: %u\n", hostCnt.irqs - cnt0.irqs);
+#endif
+   printf("  tags: %u arrived, %u reported (0xE4), %u not reported\n", arrivalsNr, latNr, arrivalsNr - latNr);
+   if (latNr > 0) {
+      uint64_t sum = 0;
+      qsort(lat, latNr, sizeof(lat[0]), cmpU64);
+      for (uint32_t i = 0; i < latNr; i++) {
+         sum += lat[i];
+      }
+      printf("  tag arrival -> 0xE4 send latency (us): min %llu avg %llu p50 %llu p95 %llu max %llu\n",
+             (unsigned long long)lat[0], (unsigned long long)(sum / latNr), (unsigned long long)lat[latNr / 2],
+             (unsigned long long)lat[(latNr * 95) / 100], (unsigned long long)lat[latNr - 1]);
+   }
+   return (latNr == arrivalsNr) ? 0 : 1;
+}
@@ -0,0 +1,910 @@
+/*
+ * Host simulation of one rfid2ln board, see hostsim.h.
+ *
+ * MFRC522 model: the registers used by the sketch and the library, the FIFO, the
+ * Transceive / Transmit / CalcCRC / SoftReset commands with the ISO 14443A air time, the
+ * timer (TAuto), the IRQ output (ComIEn / DivIEn, IRqInv). The tags follow the ISO 14443-3
+ * state machine: IDLE -REQA/WUPA-> READY -SELECT-> ACTIVE -HLTA-> HALT -WUPA-> READY*;
+ * an unexpected frame sends a READY / ACTIVE tag back to IDLE (READY* / ACTIVE* to HALT).
+ * The anticollision is bitwise: the tags matching the known bits answer, a collision
+ * reports the first differing bit in CollReg.
+ */
+#include <Arduino.h>
+#include <SPI.h>
+#include <EEPROM.h>
+#include <LocoNet.h>
+#include "hostsim.h"
+
+uint64_t hostNs = 0;
+__hostCntType hostCnt;
+void (*hostTagHook)(uint8_t rdr, const uint8_t *pUid, uint8_t len, bool bEnter) = NULL;
+void (*hostIrqHook)(uint8_t pin) = NULL;
+
+bool hostSerialOpen = true;
+bool hostSerialEcho = false;
+HardwareSerial Serial;
+SPIClass SPI;
+EEPROMClass EEPROM;
+LocoNetClass LocoNet;
+
+uint8_t hostEeprom[E2END + 1];
+uint32_t hostEeWrites = 0;
+
+/* MFRC522 registers (address >> 1)*/
+#define R_COMMAND     0x01
+#define R_COMIEN      0x02
+#define R_DIVIEN      0x03
+#define R_COMIRQ      0x04
+#define R_DIVIRQ      0x05
+#define R_ERROR       0x06
+#define R_STATUS1     0x07
+#define R_FIFODATA    0x09
+#define R_FIFOLEVEL   0x0A
+#define R_CONTROL     0x0C
+#define R_BITFRAMING  0x0D
+#define R_COLL        0x0E
+#define R_MODE        0x11
+#define R_TXCONTROL   0x14
+#define R_CRCH        0x21
+#define R_CRCL        0x22
+#define R_TMODE       0x2A
+#define R_TPRESCALER  0x2B
+#define R_TRELOADH    0x2C
+#define R_TRELOADL    0x2D
+#define R_VERSION     0x37
+
+#define CMD_IDLE       0x00
+#define CMD_CALCCRC    0x03
+#define CMD_TRANSMIT   0x04
+#define CMD_TRANSCEIVE 0x0C
+#define CMD_SOFTRESET  0x0F
+
+#define IRQ_TX         0x40
+#define IRQ_RX         0x20
+#define IRQ_IDLE       0x10
+#define IRQ_ERR        0x02
+#define IRQ_TIMER      0x01
+
+#define CHIP_VERSION   0x92    /* MFRC522 v2.0*/
+#define AIR_BIT_NS     9440    /* 106 kBd*/
+#define FDT_NS         86000   /* frame delay time PCD -> PICC answer*/
+#define CRC_NS         2000
+#define OSC_START_NS   1000000 /* oscillator start after the hard reset*/
+
+#define TAG_IDLE       0
+#define TAG_READY      1
+#define TAG_ACTIVE     2
+#define TAG_HALT       3
+
+typedef struct {
+   bool     bUsed;
+   uint8_t  uid[HOST_UID_MAX];
+   uint8_t  len;
+   uint8_t  state;
+   bool     bStar;    //woken from HALT: READY* / ACTIVE*
+   uint8_t  level;    //cascade level reached in READY
+} __tagType;
+
+typedef struct {
+   uint8_t  ss;
+   uint8_t  irq;
+   uint8_t  rst;
+   bool     bPlugged;
+   bool     bReset;       //NRSTPD low
+   uint64_t readyNs;      //oscillator running from this time
+   uint8_t  reg[64];
+   uint8_t  fifo[64];
+   uint8_t  fifoLen;
+   bool     bAddrByte;    //next byte of the frame is the address byte
+   bool     bRead;
+   uint8_t  curReg;
+   uint64_t txNs;         //end of the transmission; 0 = none
+   uint64_t rxNs;         //end of the tag answer; 0 = none
+   uint64_t timerNs;      //timer expiry; 0 = none
+   uint64_t crcNs;        //end of the CRC calculation; 0 = none
+   uint8_t  rxBuf[HOST_UID_MAX];
+   uint8_t  rxLen;
+   uint8_t  rxErr;
+   uint8_t  rxColl;
+   uint8_t  irqLevel;
+   __tagType tags[HOST_TAGS];
+} __chipType;
+
+static __chipType chips[HOST_READERS];
+static uint8_t chipsNr = 0;
+
+typedef struct {
+   uint64_t ns;
+   uint8_t  rdr;
+   uint8_t  uid[HOST_UID_MAX];
+   uint8_t  len;
+   bool     bEnter;
+} __tagEvType;
+
+static __tagEvType *tagEv = NULL;
+static uint32_t tagEvNr = 0;
+static uint32_t tagEvCap = 0;
+static uint32_t tagEvNext = 0;
+
+static uint8_t pinLevel[HOST_PINS];
+static void (*isrTab[HOST_PINS])(void);
+static int isrMode[HOST_PINS];
+static bool isrPending[HOST_PINS];
+static bool bIntOn = true;
+static bool bInIsr = false;
+
+static uint32_t spiClock = 4000000;
+static bool bSpiTrans = false;
+static uint32_t rndState = 1;
+static uint32_t noiseState = 0x2545F491;
+
+static void chipIrqUpdate(__chipType *c);
+
+struct __eeInit {
+   __eeInit() { memset(hostEeprom, 0xFF, sizeof(hostEeprom)); }
+} eeInit;
+
+/******** interrupts*/
+
+static void isrDeliver(void){
+   bool bAgain = true;
+
+   while (bIntOn && !bInIsr && bAgain) {
+      bAgain = false;
+      for (uint8_t pin = 0; pin < HOST_PINS; pin++) {
+         if (!isrPending[pin] || !bIntOn) {
+            continue;
+         }
+         isrPending[pin] = false;
+         if (isrTab[pin] == NULL) {
+            continue;
+         }
+         bInIsr = true;
+         bIntOn = false;
+         if (hostIrqHook != NULL) {
+            hostIrqHook(pin);
+         }
+         hostNs += HOST_ISR_NS;
+         isrTab[pin]();
+         hostCnt.irqs++;
+         bIntOn = true;
+         bInIsr = false;
+         bAgain = true;
+      }
+   }
+}
+
+static void pinEdge(uint8_t pin, uint8_t oldLevel, uint8_t newLevel){
+   if ((pin >= HOST_PINS) || (isrTab[pin] == NULL) || (oldLevel == newLevel)) {
+      return;
+   }
+   if ((isrMode[pin] == CHANGE) || ((isrMode[pin] == FALLING) && (newLevel == LOW)) ||
+       ((isrMode[pin] == RISING) && (newLevel == HIGH))) {
+      isrPending[pin] = true;
+      isrDeliver();
+   }
+}
+
+void attachInterrupt(uint8_t irq, void (*isr)(void), int mode){
+   if (irq < HOST_PINS) {
+      isrTab[irq] = isr;
+      isrMode[irq] = mode;
+      isrPending[irq] = false;
+   }
+}
+
+void detachInterrupt(uint8_t irq){
+   if (irq < HOST_PINS) {
+      isrTab[irq] = NULL;
+      isrPending[irq] = false;
+   }
+}
+
+void noInterrupts(void){
+   bIntOn = false;
+}
+
+void interrupts(void){
+   if (!bInIsr) {
+      bIntOn = true;
+      isrDeliver();
+   }
+}
+
+/******** ISO 14443A tags*/
+
+static uint16_t crcA(const uint8_t *pData, uint8_t len){
+   uint16_t crc = 0x6363;
+
+   for (uint8_t i = 0; i < len; i++) {
+      uint8_t b = pData[i] ^ (crc & 0xFF);
+      b ^= b << 4;
+      crc = (crc >> 8) ^ ((uint16_t)b << 8) ^ ((uint16_t)b << 3) ^ (b >> 4);
+   }
+   return crc;
+}
+
+/* the 4 UID bytes + BCC of a cascade level*/
+static void tagCascade(const __tagType *t, uint8_t level, uint8_t *pCl){
+   uint8_t levels = (t->len == 4) ? 1 : ((t->len == 7) ? 2 : 3);
+
+   if (level + 1 < levels) {
+      pCl[0] = 0x88; //cascade tag
+      memcpy(&pCl[1], &t->uid[3 * level], 3);
+   } else {
+      memcpy(pCl, &t->uid[3 * level], 4);
+   }
+   pCl[4] = pCl[0] ^ pCl[1] ^ pCl[2] ^ pCl[3];
+}
+
+static uint8_t tagLevels(const __tagType *t){
+   return (t->len == 4) ? 1 : ((t->len == 7) ? 2 : 3);
+}
+
+static uint8_t getBit(const uint8_t *p, uint8_t k){
+   return (p[k >> 3] >> (k & 7)) & 1;
+}
+
+/* READY / ACTIVE tag receiving a frame it doesn't expect*/
+static void tagUnexpected(__tagType *t){
+   if ((t->state == TAG_READY) || (t->state == TAG_ACTIVE)) {
+      t->state = t->bStar ? TAG_HALT : TAG_IDLE;
+   }
+}
+
+static void fieldOff(__chipType *c){
+   for (uint8_t i = 0; i < HOST_TAGS; i++) {
+      c->tags[i].state = TAG_IDLE;
+      c->tags[i].bStar = false;
+   }
+}
+
+/*
+ * The tags in the field receive a frame; the answer (if any) is left in rxBuf / rxLen,
+ * with the collision error and position
+ */
+static void tagsFrame(__chipType *c, const uint8_t *pFrame, uint8_t n, uint8_t lastBits){
+   uint8_t resp[HOST_TAGS][5];
+   uint8_t respNr = 0;
+   uint8_t respBits = 0;   //answer bits compared for a collision
+   uint8_t firstBit = 0;   //first answer bit (anticollision: the known bits are not sent)
+
+   c->rxLen = 0;
+   c->rxErr = 0;
+   c->rxColl = 0x20;       //CollPosNotValid
+
+   if ((n == 1) && (lastBits == 7) && ((pFrame[0] == 0x26) || (pFrame[0] == 0x52))) { //REQA / WUPA
+      boolean bWupa = (pFrame[0] == 0x52);
+      for (uint8_t i = 0; i < HOST_TAGS; i++) {
+         __tagType *t = &c->tags[i];
+         if (!t->bUsed) {
+            continue;
+         }
+         if ((t->state == TAG_IDLE) || ((t->state == TAG_HALT) && bWupa)) {
+            t->bStar = (t->state == TAG_HALT);
+            t->state = TAG_READY;
+            t->level = 0;
+            resp[respNr][0] = (t->len == 4) ? 0x04 : ((t->len == 7) ? 0x44 : 0x84); //ATQA
+            resp[respNr][1] = 0x00;
+            respNr++;
+         } else {
+            tagUnexpected(t);
+         }
+      }
+      respBits = 16;
+   } else if ((n >= 2) && (pFrame[0] == 0x50) && (pFrame[1] == 0x00)) { //HLTA
+      for (uint8_t i = 0; i < HOST_TAGS; i++) {
+         __tagType *t = &c->tags[i];
+         if (t->bUsed && (t->state == TAG_ACTIVE)) {
+            t->state = TAG_HALT;
+         } else if (t->bUsed) {
+            tagUnexpected(t);
+         }
+      }
+   } else if ((n >= 2) && ((pFrame[0] == 0x93) || (pFrame[0] == 0x95) || (pFrame[0] == 0x97))) {
+      uint8_t level = (pFrame[0] - 0x93) / 2;
+      uint8_t nvb = pFrame[1];
+      uint8_t cl[5];
+
+      if ((nvb == 0x70) && (n >= 7)) { //SELECT
+         for (uint8_t i = 0; i < HOST_TAGS; i++) {
+            __tagType *t = &c->tags[i];
+            if (!t->bUsed || (t->state != TAG_READY) || (t->level != level)) {
+               continue;
+            }
+            tagCascade(t, level, cl);
+            if (memcmp(cl, &pFrame[2], 5) != 0) {
+               continue; //not selected: stays READY
+            }
+            uint8_t sak;
+            if (level + 1 < tagLevels(t)) {
+               t->level++;
+               sak = 0x04; //UID not complete
+            } else {
+               t->state = TAG_ACTIVE;
+               sak = (t->len == 4) ? 0x08 : 0x00;
+            }
+            uint16_t crc = crcA(&sak, 1);
+            c->rxBuf[0] = sak;
+            c->rxBuf[1] = crc & 0xFF;
+            c->rxBuf[2] = crc >> 8;
+            c->rxLen = 3;
+         }
+         return;
+      }
+
+      /* ANTICOLLISION: the tags matching the known bits send the rest of the level*/
+      uint8_t known = ((nvb >> 4) - 2) * 8 + (nvb & 0x0F);
+      if ((nvb < 0x20) || (known > 32)) {
+         return;
+      }
+      for (uint8_t i = 0; i < HOST_TAGS; i++) {
+         __tagType *t = &c->tags[i];
+         if (!t->bUsed || (t->state != TAG_READY) || (t->level != level)) {
+            continue;
+         }
+         tagCascade(t, level, cl);
+         boolean bMatch = true;
+         for (uint8_t k = 0; (k < known) && bMatch; k++) {
+            bMatch = (getBit(cl, k) == getBit(&pFrame[2], k));
+         }
+         if (bMatch) {
+            memcpy(resp[respNr], cl, 5);
+            respNr++;
+         }
+      }
+      firstBit = known;
+      respBits = 40;
+   } else { //not modelled
+      for (uint8_t i = 0; i < HOST_TAGS; i++) {
+         if (c->tags[i].bUsed) {
+            tagUnexpected(&c->tags[i]);
+         }
+      }
+   }
+
+   if (respNr == 0) {
+      return;
+   }
+
+   /* the answers are received together: the first differing bit is a collision*/
+   uint8_t collBit = 0xFF;
+   for (uint8_t k = firstBit; (k < respBits) && (collBit == 0xFF); k++) {
+      for (uint8_t r = 1; r < respNr; r++) {
+         if (getBit(resp[r], k) != getBit(resp[0], k)) {
+            collBit = k;
+            break;
+         }
+      }
+   }
+
+   uint8_t first = firstBit / 8;
+   c->rxLen = respBits / 8 - first;
+   memcpy(c->rxBuf, &resp[0][first], c->rxLen);
+   if (collBit != 0xFF) {
+      for (uint8_t k = collBit; k < respBits; k++) { //ValuesAfterColl = 0: cleared after the collision
+         c->rxBuf[k / 8 - first] &= ~(1 << (k & 7));
+      }
+      c->rxErr = 0x08; //CollErr
+      c->rxColl = (collBit + 1) & 0x1F;
+   }
+}
+
+/******** MFRC522*/
+
+static void chipReset(__chipType *c){
+   memset(c->reg, 0, sizeof(c->reg));
+   c->reg[R_COMMAND] = 0x20;
+   c->reg[R_COMIEN] = 0x80;
+   c->reg[R_COMIRQ] = 0x14;
+   c->reg[R_STATUS1] = 0x21;
+   c->reg[0x0B] = 0x08;      //WaterLevelReg
+   c->reg[R_CONTROL] = 0x10;
+   c->reg[R_COLL] = 0xA0;
+   c->reg[R_MODE] = 0x3F;
+   c->reg[R_TXCONTROL] = 0x80;
+   c->reg[0x16] = 0x10;      //TxSelReg
+   c->reg[0x17] = 0x84;      //RxSelReg
+   c->reg[0x18] = 0x84;      //RxThresholdReg
+   c->reg[0x19] = 0x4D;      //DemodReg
+   c->reg[R_CRCH] = 0xFF;
+   c->reg[R_CRCL] = 0xFF;
+   c->reg[0x24] = 0x26;      //ModWidthReg
+   c->reg[0x26] = 0x48;      //RFCfgReg
+   c->reg[R_VERSION] = CHIP_VERSION;
+   c->fifoLen = 0;
+   c->txNs = 0;
+   c->rxNs = 0;
+   c->timerNs = 0;
+   c->crcNs = 0;
+   fieldOff(c);
+   chipIrqUpdate(c);
+}
+
+static bool chipAnswers(const __chipType *c){
+   return c->bPlugged && !c->bReset && (hostNs >= c->readyNs);
+}
+
+static void chipIrqUpdate(__chipType *c){
+   uint8_t level = HIGH; //pull-up of the IRQ input
+
+   if (chipAnswers(c)) {
+      boolean bActive = ((c->reg[R_COMIRQ] & c->reg[R_COMIEN] & 0x7F) != 0) ||
+                        ((c->reg[R_DIVIRQ] & c->reg[R_DIVIEN] & 0x14) != 0);
+      boolean bInv = (c->reg[R_COMIEN] & 0x80) != 0;
+      level = (bActive != bInv) ? HIGH : LOW;
+   }
+   if (level != c->irqLevel) {
+      uint8_t old = c->irqLevel;
+      c->irqLevel = level;
+      pinEdge(c->irq, old, level);
+   }
+}
+
+static uint64_t chipTimerNs(const __chipType *c){
+   uint64_t presc = ((c->reg[R_TMODE] & 0x0F) << 8) | c->reg[R_TPRESCALER];
+   uint64_t reload = (c->reg[R_TRELOADH] << 8) | c->reg[R_TRELOADL];
+
+   return (2 * presc + 1) * (reload + 1) * 1000000000ULL / 13560000ULL;
+}
+
+/* the FIFO content is sent; the tags answer (Transceive) at the end of the transmission*/
+static void chipTransmit(__chipType *c, boolean bTransceive){
+   uint8_t frame[64];
+   uint8_t n = c->fifoLen;
+   uint8_t lastBits = c->reg[R_BITFRAMING] & 0x07;
+   uint32_t bits = 2; //start / end of frame
+
+   if (n > 0) {
+      bits += lastBits ? ((n - 1) * 9 + lastBits) : (n * 9);
+   }
+   memcpy(frame, c->fifo, n);
+   c->fifoLen = 0;
+   c->reg[R_ERROR] = 0;
+   c->rxLen = 0;
+   c->rxNs = 0;
+   c->timerNs = 0;
+   c->txNs = hostNs + bits * AIR_BIT_NS;
+
+   if ((c->reg[R_TXCONTROL] & 0x03) == 0x03) { //antenna on
+      tagsFrame(c, frame, n, lastBits);
+   }
+   if (!bTransceive) {
+      return;
+   }
+   if (c->rxLen > 0) {
+      c->rxNs = c->txNs + FDT_NS + (c->rxLen * 9 + 2) * AIR_BIT_NS;
+   } else if (c->reg[R_TMODE] & 0x80) { //TAuto
+      c->timerNs = c->txNs + chipTimerNs(c);
+   }
+}
+
+static uint8_t chipRead(__chipType *c, uint8_t r){
+   switch (r) {
+      case R_FIFODATA: {
+         if (c->fifoLen == 0) {
+            return 0;
+         }
+         uint8_t v = c->fifo[0];
+         c->fifoLen--;
+         memmove(c->fifo, &c->fifo[1], c->fifoLen);
+         return v;
+      }
+      case R_FIFOLEVEL:
+         return c->fifoLen;
+      default:
+         return c->reg[r];
+   }
+}
+
+static void chipWrite(__chipType *c, uint8_t r, uint8_t v){
+   switch (r) {
+      case R_COMMAND:
+         c->reg[R_COMMAND] = (c->reg[R_COMMAND] & 0xF0) | (v & 0x3F);
+         switch (v & 0x0F) {
+            case CMD_IDLE:
+               c->txNs = 0;
+               c->rxNs = 0;
+               c->timerNs = 0;
+               c->crcNs = 0;
+               break;
+            case CMD_SOFTRESET:
+               chipReset(c);
+               return;
+            case CMD_CALCCRC: {
+               uint16_t crc = crcA(c->fifo, c->fifoLen);
+               c->reg[R_CRCL] = crc & 0xFF;
+               c->reg[R_CRCH] = crc >> 8;
+               c->fifoLen = 0;
+               c->crcNs = hostNs + CRC_NS;
+               break;
+            }
+            case CMD_TRANSMIT:
+               chipTransmit(c, false);
+               break;
+            default: //Transceive waits for StartSend
+               break;
+         }
+         break;
+      case R_COMIRQ:
+      case R_DIVIRQ:
+         if (v & 0x80) { //Set1
+            c->reg[r] |= v & 0x7F;
+         } else {
+            c->reg[r] &= ~(v & 0x7F);
+         }
+         break;
+      case R_FIFODATA:
+         if (c->fifoLen < sizeof(c->fifo)) {
+            c->fifo[c->fifoLen++] = v;
+         }
+         break;
+      case R_FIFOLEVEL:
+         if (v & 0x80) { //FlushBuffer
+            c->fifoLen = 0;
+         }
+         break;
+      case R_BITFRAMING:
+         c->reg[r] = v & 0x7F;
+         if ((v & 0x80) && ((c->reg[R_COMMAND] & 0x0F) == CMD_TRANSCEIVE)) { //StartSend
+            chipTransmit(c, true);
+         }
+         break;
+      case R_TXCONTROL: {
+         boolean bWasOn = (c->reg[r] & 0x03) == 0x03;
+         c->reg[r] = v;
+         if (bWasOn && ((v & 0x03) != 0x03)) {
+            fieldOff(c);
+         }
+         break;
+      }
+      case R_COLL:
+         c->reg[r] = (c->reg[r] & 0x7F) | (v & 0x80);
+         break;
+      case R_ERROR:
+      case R_STATUS1:
+      case R_VERSION:
+         break; //read only
+      default:
+         c->reg[r] = v;
+         break;
+   }
+   chipIrqUpdate(c);
+}
+
+/* one byte of a chip select frame: address byte, then data (write) or next address (read)*/
+static uint8_t chipByte(__chipType *c, uint8_t out){
+   if (!chipAnswers(c)) {
+      return 0xFF; //no MISO driver
+   }
+   if (c->bAddrByte) {
+      c->bAddrByte = false;
+      c->bRead = (out & 0x80) != 0;
+      c->curReg = (out >> 1) & 0x3F;
+      return 0x00;
+   }
+   if (c->bRead) {
+      uint8_t v = chipRead(c, c->curReg);
+      c->curReg = (out >> 1) & 0x3F;
+      return v;
+   }
+   chipWrite(c, c->curReg, out);
+   return 0x00;
+}
+
+static void chipEvents(__chipType *c){
+   if (c->crcNs && (c->crcNs <= hostNs)) {
+      c->crcNs = 0;
+      c->reg[R_DIVIRQ] |= 0x04; //CRCIRq
+   }
+   if (c->txNs && (c->txNs <= hostNs)) {
+      c->txNs = 0;
+      c->reg[R_COMIRQ] |= IRQ_TX;
+      if ((c->reg[R_COMMAND] & 0x0F) == CMD_TRANSMIT) { //done => Idle
+         c->reg[R_COMMAND] &= 0xF0;
+         c->reg[R_COMIRQ] |= IRQ_IDLE;
+      }
+   }
+   if (c->rxNs && (c->rxNs <= hostNs)) {
+      c->rxNs = 0;
+      memcpy(c->fifo, c->rxBuf, c->rxLen);
+      c->fifoLen = c->rxLen;
+      c->reg[R_ERROR] = c->rxErr;
+      c->reg[R_COLL] = (c->reg[R_COLL] & 0x80) | c->rxColl;
+      c->reg[R_CONTROL] &= 0xF8; //RxLastBits: whole bytes
+      c->reg[R_COMIRQ] |= IRQ_RX | (c->rxErr ? IRQ_ERR : 0);
+   }
+   if (c->timerNs && (c->timerNs <= hostNs)) {
+      c->timerNs = 0;
+      c->reg[R_COMIRQ] |= IRQ_TIMER;
+   }
+   chipIrqUpdate(c);
+}
+
+static uint64_t chipNextNs(const __chipType *c){
+   uint64_t t = UINT64_MAX;
+   const uint64_t ev[] = {c->crcNs, c->txNs, c->rxNs, c->timerNs, (c->readyNs > hostNs) ? c->readyNs : 0};
+
+   for (uint8_t i = 0; i < sizeof(ev) / sizeof(ev[0]); i++) {
+      if ((ev[i] != 0) && (ev[i] < t)) {
+         t = ev[i];
+      }
+   }
+   return t;
+}
+
+uint8_t hostReaderAdd(uint8_t ssPin, uint8_t irqPin, uint8_t rstPin){
+   __chipType *c = &chips[chipsNr];
+
+   memset(c, 0, sizeof(*c));
+   c->ss = ssPin;
+   c->irq = irqPin;
+   c->rst = rstPin;
+   c->bPlugged = true;
+   c->bAddrByte = true;
+   c->irqLevel = HIGH;
+   pinLevel[ssPin] = HIGH;
+   pinLevel[rstPin] = HIGH; //pull-up of the reader module
+   chipReset(c);
+   return chipsNr++;
+}
+
+void hostReaderPlug(uint8_t rdr, bool bPlugged){
+   __chipType *c = &chips[rdr];
+
+   if (bPlugged && !c->bPlugged) { //power on reset
+      chipReset(c);
+      c->readyNs = hostNs + OSC_START_NS;
+   }
+   c->bPlugged = bPlugged;
+   chipIrqUpdate(c);
+}
+
+void hostReaderGlitch(uint8_t rdr){
+   chipReset(&chips[rdr]);
+}
+
+bool hostTagEnter(uint8_t rdr, const uint8_t *pUid, uint8_t len){
+   __chipType *c = &chips[rdr];
+
+   for (uint8_t i = 0; i < HOST_TAGS; i++) {
+      if (!c->tags[i].bUsed) {
+         __tagType *t = &c->tags[i];
+         memset(t, 0, sizeof(*t));
+         memcpy(t->uid, pUid, len);
+         t->len = len;
+         t->state = TAG_IDLE;
+         t->bUsed = true;
+         return true;
+      }
+   }
+   return false;
+}
+
+void hostTagLeave(uint8_t rdr, const uint8_t *pUid, uint8_t len){
+   __chipType *c = &chips[rdr];
+
+   for (uint8_t i = 0; i < HOST_TAGS; i++) {
+      if (c->tags[i].bUsed && (c->tags[i].len == len) && (memcmp(c->tags[i].uid, pUid, len) == 0)) {
+         c->tags[i].bUsed = false;
+      }
+   }
+}
+
+void hostTagSchedule(uint64_t us, uint8_t rdr, const uint8_t *pUid, uint8_t len, bool bEnter){
+   if (tagEvNr == tagEvCap) {
+      tagEvCap = tagEvCap ? 2 * tagEvCap : 64;
+      tagEv = (__tagEvType *)realloc(tagEv, tagEvCap * sizeof(__tagEvType));
+   }
+   uint32_t i = tagEvNr++;
+   while ((i > tagEvNext) && (tagEv[i - 1].ns > us * 1000)) { //sorted by time, FIFO for the same time
+      tagEv[i] = tagEv[i - 1];
+      i--;
+   }
+   tagEv[i].ns = us * 1000;
+   tagEv[i].rdr = rdr;
+   memcpy(tagEv[i].uid, pUid, len);
+   tagEv[i].len = len;
+   tagEv[i].bEnter = bEnter;
+}
+
+/******** clock*/
+
+static uint64_t nextEventNs(void){
+   uint64_t t = UINT64_MAX;
+
+   for (uint8_t i = 0; i < chipsNr; i++) {
+      uint64_t tc = chipNextNs(&chips[i]);
+      if (tc < t) {
+         t = tc;
+      }
+   }
+   if ((tagEvNext < tagEvNr) && (tagEv[tagEvNext].ns < t)) {
+      t = tagEv[tagEvNext].ns;
+   }
+   return t;
+}
+
+static void runEvents(void){
+   for (uint8_t i = 0; i < chipsNr; i++) {
+      chipEvents(&chips[i]);
+   }
+   while ((tagEvNext < tagEvNr) && (tagEv[tagEvNext].ns <= hostNs)) {
+      __tagEvType *e = &tagEv[tagEvNext++];
+      if (e->bEnter) {
+         hostTagEnter(e->rdr, e->uid, e->len);
+      } else {
+         hostTagLeave(e->rdr, e->uid, e->len);
+      }
+      if (hostTagHook != NULL) {
+         hostTagHook(e->rdr, e->uid, e->len, e->bEnter);
+      }
+   }
+}
+
+void hostAdvanceNs(uint64_t ns){
+   uint64_t target = hostNs + ns;
+
+   for (;;) {
+      uint64_t t = nextEventNs();
+      if (t > target) {
+         break;
+      }
+      if (t > hostNs) {
+         hostNs = t;
+      }
+      runEvents();
+   }
+   if (target > hostNs) {
+      hostNs = target;
+   }
+}
+
+unsigned long millis(void){
+   hostAdvanceNs(HOST_MILLIS_NS);
+   return hostNs / 1000000;
+}
+
+unsigned long micros(void){
+   hostAdvanceNs(HOST_MICROS_NS);
+   return hostNs / 1000;
+}
+
+void delay(unsigned long ms){
+   hostAdvanceNs((uint64_t)ms * 1000000);
+}
+
+void delayMicroseconds(unsigned int us){
+   hostAdvanceNs((uint64_t)us * 1000);
+}
+
+/******** pins*/
+
+void pinMode(uint8_t pin, uint8_t mode){
+   hostAdvanceNs(HOST_PIN_READ_NS);
+   if ((mode == INPUT_PULLUP) && (pin < HOST_PINS)) {
+      pinLevel[pin] = HIGH;
+   }
+}
+
+void digitalWrite(uint8_t pin, uint8_t val){
+   hostAdvanceNs(HOST_PIN_WRITE_NS);
+   if (pin >= HOST_PINS) {
+      return;
+   }
+   uint8_t old = pinLevel[pin];
+   pinLevel[pin] = val ? HIGH : LOW;
+   if (old == pinLevel[pin]) {
+      return;
+   }
+   for (uint8_t i = 0; i < chipsNr; i++) {
+      __chipType *c = &chips[i];
+      if ((pin == c->ss) && (val == LOW)) { //start of a chip select frame
+         c->bAddrByte = true;
+         hostCnt.spiFrames++;
+      }
+      if (pin == c->rst) {
+         if (val == LOW) { //hard power down
+            chipReset(c);
+            c->bReset = true;
+         } else {
+            c->bReset = false;
+            c->readyNs = hostNs + OSC_START_NS;
+         }
+         chipIrqUpdate(c);
+      }
+   }
+}
+
+uint8_t hostPinLevel(uint8_t pin){
+   for (uint8_t i = 0; i < chipsNr; i++) {
+      if (pin == chips[i].irq) {
+         return chips[i].irqLevel;
+      }
+   }
+   return (pin < HOST_PINS) ? pinLevel[pin] : LOW;
+}
+
+int digitalRead(uint8_t pin){
+   hostAdvanceNs(HOST_PIN_READ_NS);
+   return hostPinLevel(pin);
+}
+
+int analogRead(uint8_t pin){
+   hostAdvanceNs(112000); //one conversion
+   noiseState ^= noiseState << 13;
+   noiseState ^= noiseState >> 17;
+   noiseState ^= noiseState << 5;
+   return (noiseState ^ pin) & 0x3FF;
+}
+
+/******** random*/
+
+void hostSeed(uint32_t seed){
+   noiseState = seed ? seed : 0x2545F491;
+   rndState = seed | 1;
+}
+
+void randomSeed(unsigned long seed){
+   if (seed != 0) {
+      rndState = seed;
+   }
+}
+
+long random(long howbig){
+   if (howbig == 0) {
+      return 0;
+   }
+   rndState = rndState * 1103515245UL + 12345UL;
+   return (long)((rndState >> 1) % (uint32_t)howbig);
+}
+
+long random(long howsmall, long howbig){
+   if (howsmall >= howbig) {
+      return howsmall;
+   }
+   return howsmall + random(howbig - howsmall);
+}
+
+/******** SPI*/
+
+void SPIClass::begin(void){
+}
+
+void SPIClass::beginTransaction(SPISettings settings){
+   if (bSpiTrans) {
+      fprintf(stderr, "hostsim: SPI.beginTransaction() inside an open transaction\n");
+   }
+   bSpiTrans = true;
+   spiClock = settings.clock;
+   hostCnt.spiTrans++;
+}
+
+void SPIClass::endTransaction(void){
+   bSpiTrans = false;
+}
+
+uint8_t SPIClass::transfer(uint8_t data){
+   __chipType *pSel = NULL;
+
+   hostAdvanceNs(8000000000ULL / spiClock + HOST_SPI_BYTE_NS);
+   hostCnt.spiBytes++;
+   for (uint8_t i = 0; i < chipsNr; i++) {
+      if (pinLevel[chips[i].ss] == LOW) {
+         if (pSel != NULL) {
+            fprintf(stderr, "hostsim: two readers selected\n");
+            return 0x00;
+         }
+         pSel = &chips[i];
+      }
+   }
+   return (pSel != NULL) ? chipByte(pSel, data) : 0xFF;
+}
+
+void SPIClass::transfer(void *buf, size_t count){
+   uint8_t *p = (uint8_t *)buf;
+
+   for (size_t i = 0; i < count; i++) {
+      p[i] = transfer(p[i]);
+   }
+}
@@ -0,0 +1,90 @@
+/*
+ * Host simulation of one rfid2ln board: simulated clock, pins, interrupts, SPI bus with the
+ * MFRC522 readers and the tags in their field, EEPROM. The sketch runs unchanged on top of
+ * the stubs in stubs/; the host program (benchmark, tests, bus simulator) calls setup() and
+ * loop() and drives the tags with the functions below.
+ *
+ * The time advances only with the modelled cost of the Arduino calls (an ATmega32U4 at
+ * 16 MHz): SPI bytes, pin writes, micros() / millis(), delays, EEPROM writes, plus
+ * HOST_LOOP_US per loop() pass for the code around them. The numbers compare variants
+ * of the sketch; they don't replace a measurement on the board.
+ */
+#ifndef HOSTSIM_H_
+#define HOSTSIM_H_
+
+#include <Arduino.h>
+#include <LocoNet.h>
+#include <utility/ln_sw_uart.h>
+
+#define HOST_SPI_BYTE_NS     500     /* call overhead of SPI.transfer(), on top of the 8 clock periods*/
+#define HOST_PIN_WRITE_NS    3500    /* digitalWrite()*/
+#define HOST_PIN_READ_NS     3000    /* digitalRead() / pinMode()*/
+#define HOST_MICROS_NS       3500    /* micros()*/
+#define HOST_MILLIS_NS       1500    /* millis()*/
+#define HOST_LOOP_US         15      /* loop() code not calling the modelled functions*/
+#define HOST_ISR_NS          4000    /* interrupt entry / exit*/
+
+#define HOST_PINS            72
+#define HOST_READERS         8
+#define HOST_TAGS            6       /* tags in the field of one reader*/
+#define HOST_UID_MAX         10
+
+extern uint64_t hostNs;              /* simulated time*/
+
+inline uint64_t hostUs(void){
+   return hostNs / 1000;
+}
+
+/* advance the simulated time: reader events, tag script and interrupts up to the new time*/
+extern void hostAdvanceNs(uint64_t ns);
+inline void hostAdvanceUs(uint64_t us){
+   hostAdvanceNs(us * 1000);
+}
+
+/*
+ * Readers: one MFRC522 on the SS pin, its IRQ output on irqPin (0xFF = not wired), its
+ * NRSTPD on rstPin. A reader unplugged answers 0xFF (no MISO driver); a glitch puts the
+ * registers back to the reset values (brown-out), the tags lose the field
+ */
+extern uint8_t hostReaderAdd(uint8_t ssPin, uint8_t irqPin, uint8_t rstPin);
+extern void hostReaderPlug(uint8_t rdr, bool bPlugged);
+extern void hostReaderGlitch(uint8_t rdr);
+
+/* tags (ISO 14443A, 4 / 7 / 10 byte UID) entering / leaving the field of a reader*/
+extern bool hostTagEnter(uint8_t rdr, const uint8_t *pUid, uint8_t len);
+extern void hostTagLeave(uint8_t rdr, const uint8_t *pUid, uint8_t len);
+extern void hostTagSchedule(uint64_t us, uint8_t rdr, const uint8_t *pUid, uint8_t len, bool bEnter);
+
+/* called with the simulated time of each scheduled tag event, when it takes place*/
+extern void (*hostTagHook)(uint8_t rdr, const uint8_t *pUid, uint8_t len, bool bEnter);
+
+/* called at the entry of each interrupt served, with the pin*/
+extern void (*hostIrqHook)(uint8_t pin);
+
+typedef struct {
+   uint32_t spiTrans;   //SPI.beginTransaction() calls
+   uint32_t spiFrames;  //chip select frames of the readers
+   uint32_t spiBytes;   //bytes on the bus
+   uint32_t irqs;       //reader interrupts served
+} __hostCntType;
+
+extern __hostCntType hostCnt;
+
+/* the pin level: written by the sketch or, for a reader IRQ pin, driven by the reader*/
+extern uint8_t hostPinLevel(uint8_t pin);
+
+/* deterministic seed of random() / analogRead(); different per board*/
+extern void hostSeed(uint32_t seed);
+
+/*
+ * The LocoNet bus of the board, given by the host program: wire_single.cpp (the board alone)
+ * or wire_node.cpp (a node of the lnsim bus)
+ */
+#define LN_BYTE_US       (10 * LN_BIT_US)
+#define HOST_LN_TRY_NS   20000   /* one sendLocoNetPacketTry() call*/
+#define HOST_LN_RX_NS    2000    /* one LocoNet.receive() call*/
+
+extern LN_STATUS hostLnSendTry(lnMsg *pMsg, uint8_t ucPrioDelay);
+extern lnMsg *hostLnReceive(void);
+
+#endif //HOSTSIM_H_
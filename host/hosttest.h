@@ -0,0 +1,128 @@
+/*
+ * Helpers of the host tests: checks, the board boot with its readers and the loop() runs.
+ * Each test is one program with the sketch, hostsim.cpp and wire_single.cpp; it returns 0
+ * when all the checks passed.
+ */
+#ifndef HOSTTEST_H_
+#define HOSTTEST_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <SPI.h>
+#include <EEPROM.h>
+#include <MFRC522.h>
+#include <LocoNet.h>
+#include "hostsim.h"
+#include "wire_single.h"
+#include "../rfid2ln.h"
+
+extern void setup(void);
+extern void loop(void);
+
+#define TEST_BOOT_US  300000   /* boot done*/
+#define HOLDOFF_US    (PRES_HOLDOFF_DEF * 10000UL)   /* default presence hold-off*/
+#define DEBOUNCE_US   (PRES_DEBOUNCE_DEF * 1000UL)   /* default free report debounce time*/
+
+static int testFails = 0;
+
+#define CHECK(cond) do { \
+      if (!(cond)) { \
+         printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         testFails++; \
+      } \
+   } while (0)
+
+/* loop() passes until the simulated time us*/
+static void testRunUntil(uint64_t us){
+   while (hostUs() < us) {
+      hostAdvanceUs(HOST_LOOP_US);
+      loop();
+   }
+}
+
+static void testRunUs(uint64_t us){
+   testRunUntil(hostUs() + us);
+}
+
+/* all the readers of RFID_SS_PINS, the first 'readers' plugged; setup() and the boot*/
+static void testBoot(uint8_t readers){
+   const uint8_t ssPins[] = RFID_SS_PINS;
+#if USE_INTERRUPTS
+   const uint8_t irqPins[] = RFID_IRQ_PINS;
+#endif
+
+   hostSeed(1);
+   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+#if USE_INTERRUPTS
+      hostReaderAdd(ssPins[i], irqPins[i], RST_PIN);
+#else
+      hostReaderAdd(ssPins[i], 0xFF, RST_PIN);
+#endif
+      hostReaderPlug(i, i < readers);
+   }
+   setup();
+   testRunUntil(TEST_BOOT_US);
+}
+
+/* the index of the first message sent from the log entry 'from' with the given first bytes; -1 = none*/
+static int testFindMsg(uint32_t from, const uint8_t *pBytes, uint8_t len){
+   for (uint32_t i = from; i < hostLnLogNr; i++) {
+      if (memcmp(hostLnLog[i].msg.data, pBytes, len) == 0) {
+         return (int)i;
+      }
+   }
+   return -1;
+}
+
+/* the number of messages sent from the log entry 'from' with the given first bytes*/
+static uint32_t testCountMsg(uint32_t from, const uint8_t *pBytes, uint8_t len){
+   uint32_t n = 0;
+
+   for (int idx = testFindMsg(from, pBytes, len); idx >= 0; idx = testFindMsg(idx + 1, pBytes, len)) {
+      n++;
+   }
+   return n;
+}
+
+/* the 0xE4 UID message of the port as the README gives it, without the check summ*/
+static void testUidMsg(uint8_t port, const uint8_t *pUid, uint8_t len, uint8_t *pMsg){
+   uint8_t msbs = 0;
+
+   pMsg[0] = 0xE4;
+   pMsg[1] = 0x0E;
+   pMsg[2] = 0x41;
+   pMsg[3] = rfidPorts[port].addrHiSen;
+   pMsg[4] = rfidPorts[port].addrLoSen;
+   for (uint8_t i = 0; i < UID_LEN; i++) {
+      uint8_t b = (i < len) ? pUid[i] : 0;
+      pMsg[5 + i] = b & 0x7F;
+      msbs |= (b >> 7) << i;
+   }
+   pMsg[5 + UID_LEN] = msbs;
+}
+
+/* the 0xB2 message of the port, without the check summ*/
+static void testSensorMsg(uint8_t port, bool bOccupied, uint8_t *pMsg){
+   uint16_t addr = (rfidPorts[port].addrSenFull - 1) / 2;
+
+   pMsg[0] = OPC_INPUT_REP;
+   pMsg[1] = addr & 0x7F;
+   pMsg[2] = ((addr >> 7) & 0x0F) | 0x40 | ((rfidPorts[port].addrSenFull & 0x01) ? 0 : 0x20) | (bOccupied ? 0x10 : 0);
+}
+
+/* other boards keep the bus busy from now on for us: the messages of the board wait in the ring*/
+static void testBusBusy(uint64_t us){
+   const uint8_t msg[] = {OPC_INPUT_REP, 0x7F, 0x4F, 0xFF ^ OPC_INPUT_REP ^ 0x7F ^ 0x4F}; //sensor 4096 of another board
+   uint64_t end = hostUs() + us;
+
+   for (uint64_t t = hostUs() + sizeof(msg) * LN_BYTE_US; t < end; t += sizeof(msg) * LN_BYTE_US) {
+      hostLnInject(t, msg);
+   }
+}
+
+static int testResult(const char *pName){
+   printf("%s: %s\n", pName, testFails ? "FAILED" : "passed");
+   return testFails ? 1 : 0;
+}
+
+#endif //HOSTTEST_H_
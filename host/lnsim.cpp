@@ -0,0 +1,603 @@
+/*
+ * Multi-node LocoNet bus simulator: several boards, each one the unchanged sketch on its own
+ * simulated board (a copy of lnsim_node.so, see lnsim.h), on one LocoNet wire. A train
+ * triggers the readers of all the boards at nearly the same time, once per burst period;
+ * the boards contend for the wire with the priority policy given to all of them.
+ *
+ * The wire:
+ *  - bit time LN_BIT_US; a byte is a start bit, 8 data bits (LSB first) and a stop bit.
+ *  - an attempt sees the traffic started more than the sense window ago (the start bit edge
+ *    and the receiver state of the library); an attempt within the window starts too.
+ *  - the line is a wired-AND: each transmitter reads the line in the middle of its own bits;
+ *    a 1 read as 0 is a collision, the transmitter sends a break of LN_COLLISION_TICKS bits
+ *    and its attempt ends with LN_COLLISION.
+ *  - carrier detect and priority backoff count the bit times since the end of the last
+ *    traffic (message or break), as in wire_single.cpp.
+ *  - a message sent completely is received by the other nodes at its end.
+ *
+ * The nodes run as coroutines. A node runs freely between its bus calls; a bus call is
+ * served when all the other nodes are at a later time, the earliest first (the lower node
+ * on a tie), so a run depends only on its options.
+ *
+ * Reported per node: tags arrived and not reported, the latency from the tag arrival to the
+ * end of its 0xE4 message on the wire (percentiles), attempts and collisions.
+ *
+ * lnsim [-p legacy|hash|queue] [-n nodes] [-a first address] [-s address step] [-l levels]
+ *       [-r readers] [-t seconds] [-b burst period ms] [-j jitter ms] [-d dwell ms]
+ *       [-w sense window us] [-S seed]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <ucontext.h>
+#include <sys/wait.h>
+#include <SPI.h>
+#include <MFRC522.h>
+#include "lnsim.h"
+#include "../rfid2ln.h"
+
+#define LNSIM_NODES_MAX   32
+#define LNSIM_STACK       (256 * 1024)
+#define LNSIM_START_US    1000000   /* the first burst; the boards are booted*/
+#define LNSIM_TAGS_MAX    4096      /* per node*/
+#define LNSIM_GROUP       0xFF      /* the scheduler event is the open attempt group*/
+#define LNSIM_POLICY_BAD  -2
+
+typedef enum {
+   NODE_CALL_TX,     //sendTry() waiting for its turn
+   NODE_CALL_RX,     //receive() waiting for its turn
+   NODE_TX_WAIT,     //transmitting, the outcome isn't known yet
+   NODE_TX_OVER      //attempt over at callNs
+} __nodeStateType;
+
+typedef struct {
+   uint8_t  rdr;
+   uint8_t  uid[UID_LEN];
+   uint64_t us;
+   uint64_t latNs;   //0 = not reported
+} __simArrivalType;
+
+typedef struct {
+   const __lnNodeType *pApi;
+   ucontext_t ctx;
+   __nodeStateType state;
+   uint64_t callNs;        //time of the pending call / end of the attempt
+   const lnMsg *pMsg;
+   uint8_t  prio;
+   LN_STATUS result;
+   const lnMsg *pRx;
+   uint32_t rxNext;        //next wire log entry to receive
+   uint8_t  addr;
+   uint32_t attempts;
+   uint32_t collisions;
+   __simArrivalType *pArr;
+   uint32_t arrNr;
+} __simNodeType;
+
+/* one transmitter of the open attempt group*/
+typedef struct {
+   uint8_t  node;
+   uint64_t startNs;
+   uint16_t bits;
+   lnMsg    msg;
+   boolean  bBreak;
+   uint64_t brkNs;         //break start
+   uint64_t endNs;
+   uint16_t nextBit;       //next bit to read back
+} __simTxType;
+
+/* a message received by the other nodes*/
+typedef struct {
+   uint8_t  node;
+   uint64_t startNs;
+   uint64_t endNs;
+   lnMsg    msg;
+} __simLogType;
+
+static __simNodeType nodes[LNSIM_NODES_MAX];
+static uint8_t nodesNr = 4;
+static uint8_t curNode;
+static ucontext_t schedCtx;
+
+static __simTxType group[LNSIM_NODES_MAX];
+static uint8_t groupNr = 0;
+static uint64_t lastEndNs = 0;  //end of the last traffic
+static uint64_t senseNs = 30000;
+
+static __simLogType *wireLog = NULL;
+static uint32_t wireLogNr = 0;
+static uint32_t wireLogCap = 0;
+
+static const uint64_t bitNs = LN_BIT_US * 1000ULL;
+
+/************ the wire*****************/
+
+/* bit k of the message as sent: start bit, 8 data bits LSB first, stop bit*/
+static uint8_t txBit(const __simTxType *pTx, uint16_t k){
+   uint8_t b = k % 10;
+
+   if (b == 0) {
+      return 0;
+   }
+   if (b == 9) {
+      return 1;
+   }
+   return (pTx->msg.data[k / 10] >> (b - 1)) & 0x01;
+}
+
+/* level driven by the transmitter at the time ns*/
+static uint8_t txLevel(const __simTxType *pTx, uint64_t ns){
+   if (pTx->bBreak && (ns >= pTx->brkNs)) {
+      return (ns < pTx->endNs) ? 0 : 1;
+   }
+   if ((ns < pTx->startNs) || (ns >= pTx->startNs + pTx->bits * bitNs)) {
+      return 1;
+   }
+   return txBit(pTx, (ns - pTx->startNs) / bitNs);
+}
+
+static void wireLogAdd(const __simTxType *pTx){
+   if (wireLogNr == wireLogCap) {
+      wireLogCap = wireLogCap ? 2 * wireLogCap : 1024;
+      wireLog = (__simLogType *)realloc(wireLog, wireLogCap * sizeof(__simLogType));
+   }
+   uint32_t i = wireLogNr++;
+   while ((i > 0) && (wireLog[i - 1].endNs > pTx->endNs)) { //in the order of their end
+      wireLog[i] = wireLog[i - 1];
+      i--;
+   }
+   wireLog[i].node = pTx->node;
+   wireLog[i].startNs = pTx->startNs;
+   wireLog[i].endNs = pTx->endNs;
+   wireLog[i].msg = pTx->msg;
+}
+
+/*
+ * The sense window of the first transmitter is over: no other node can join the group. The
+ * read back of all the transmitters is replayed in time order; a collision starts a break
+ */
+static void groupResolve(void){
+   for (;;) {
+      __simTxType *pNext = NULL;
+      uint64_t sampleNs = 0;
+      for (uint8_t i = 0; i < groupNr; i++) {
+         __simTxType *pTx = &group[i];
+         if (pTx->bBreak || (pTx->nextBit >= pTx->bits)) {
+            continue;
+         }
+         uint64_t ns = pTx->startNs + pTx->nextBit * bitNs + bitNs / 2;
+         if ((pNext == NULL) || (ns < sampleNs)) {
+            pNext = pTx;
+            sampleNs = ns;
+         }
+      }
+      if (pNext == NULL) {
+         break;
+      }
+      if (txBit(pNext, pNext->nextBit) == 1) {
+         uint8_t line = 1;
+         for (uint8_t i = 0; i < groupNr; i++) {
+            line &= txLevel(&group[i], sampleNs);
+         }
+         if (line == 0) {
+            pNext->bBreak = true;
+            pNext->brkNs = sampleNs;
+            pNext->endNs = sampleNs + LN_COLLISION_TICKS * bitNs;
+            continue;
+         }
+      }
+      pNext->nextBit++;
+   }
+
+   for (uint8_t i = 0; i < groupNr; i++) {
+      __simTxType *pTx = &group[i];
+      __simNodeType *n = &nodes[pTx->node];
+      n->attempts++;
+      if (pTx->bBreak) {
+         n->collisions++;
+         n->result = LN_COLLISION;
+      } else {
+         pTx->endNs = pTx->startNs + pTx->bits * bitNs;
+         n->result = LN_DONE;
+         wireLogAdd(pTx);
+      }
+      n->state = NODE_TX_OVER;
+      n->callNs = pTx->endNs;
+      if (pTx->endNs > lastEndNs) {
+         lastEndNs = pTx->endNs;
+      }
+   }
+   groupNr = 0;
+}
+
+/* the attempt of the node at its call time: a backoff status, or it starts transmitting*/
+static void wireAttempt(__simNodeType *n){
+   uint64_t nowNs = n->callNs;
+
+   if (nowNs < lastEndNs) {
+      n->result = LN_NETWORK_BUSY;
+      n->state = NODE_TX_OVER;
+      return;
+   }
+   /* an open group started less than the sense window ago: not seen*/
+   uint64_t bits = (nowNs - lastEndNs) / bitNs;
+   if (bits < LN_CARRIER_TICKS) {
+      n->result = LN_CD_BACKOFF;
+      n->state = NODE_TX_OVER;
+      return;
+   }
+   if (bits < n->prio) {
+      n->result = LN_PRIO_BACKOFF;
+      n->state = NODE_TX_OVER;
+      return;
+   }
+
+   __simTxType *pTx = &group[groupNr++];
+   pTx->node = n - nodes;
+   pTx->startNs = nowNs;
+   pTx->bits = getLnMsgSize((lnMsg *)n->pMsg) * 10;
+   pTx->msg = *n->pMsg;
+   pTx->bBreak = false;
+   pTx->nextBit = 0;
+   n->state = NODE_TX_WAIT;
+}
+
+static const lnMsg *wireReceive(__simNodeType *n){
+   uint8_t node = n - nodes;
+
+   while ((n->rxNext < wireLogNr) && (wireLog[n->rxNext].endNs <= n->callNs)) {
+      const __simLogType *pLog = &wireLog[n->rxNext++];
+      if (pLog->node != node) { //no echo, as wire_single.cpp
+         return &pLog->msg;
+      }
+   }
+   return NULL;
+}
+
+/************ the nodes*****************/
+
+static void nodeYield(__simNodeType *n){
+   swapcontext(&n->ctx, &schedCtx);
+}
+
+static LN_STATUS busSendTry(uint8_t node, const lnMsg *pMsg, uint8_t ucPrioDelay, uint64_t nowNs, uint64_t *pEndNs){
+   __simNodeType *n = &nodes[node];
+
+   n->state = NODE_CALL_TX;
+   n->callNs = nowNs;
+   n->pMsg = pMsg;
+   n->prio = ucPrioDelay;
+   nodeYield(n);
+   *pEndNs = n->callNs;
+   return n->result;
+}
+
+static const lnMsg *busReceive(uint8_t node, uint64_t nowNs){
+   __simNodeType *n = &nodes[node];
+
+   n->state = NODE_CALL_RX;
+   n->callNs = nowNs;
+   nodeYield(n);
+   return n->pRx;
+}
+
+static const __lnBusType lnBus = {busSendTry, busReceive};
+
+static uint8_t ucPolicy;
+static uint8_t ucLevels = LN_PRIO_LVL_DEF;
+
+/* the board: boot, then the address and the priority policy as written over LocoNet*/
+static void nodeMain(void){
+   __simNodeType *n = &nodes[curNode];
+   const __lnNodeType *pApi = n->pApi;
+
+   pApi->setup();
+   pApi->svWrite(SV_ADDR_NODE_ID_L, n->addr);
+   pApi->svWrite(SV_ADDR_USER_BASE + SV_CFG_PRIO, ucPolicy);
+   pApi->svWrite(SV_ADDR_USER_BASE + SV_CFG_PRIO_LVL, ucLevels);
+   pApi->reconfigure();
+   for (;;) {
+      pApi->advanceNs(HOST_LOOP_US * 1000);
+      pApi->loop();
+   }
+}
+
+/* a copy of the node library per node: the same file is loaded only once*/
+static const __lnNodeType *nodeLoad(const char *pLib, uint8_t node){
+   char path[4096];
+   snprintf(path, sizeof(path), "%s.%d.%u", pLib, (int)getpid(), node);
+
+   FILE *pIn = fopen(pLib, "rb");
+   FILE *pOut = fopen(path, "wb");
+   if ((pIn == NULL) || (pOut == NULL)) {
+      fprintf(stderr, "lnsim: can't copy %s to %s\n", pLib, path);
+      exit(2);
+   }
+   char buf[65536];
+   size_t len;
+   while ((len = fread(buf, 1, sizeof(buf), pIn)) > 0) {
+      fwrite(buf, 1, len, pOut);
+   }
+   fclose(pIn);
+   fclose(pOut);
+
+   void *pHandle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+   unlink(path);
+   if (pHandle == NULL) {
+      fprintf(stderr, "lnsim: %s\n", dlerror());
+      exit(2);
+   }
+   lnNodeAttachFn attach = (lnNodeAttachFn)dlsym(pHandle, LN_NODE_ATTACH);
+   if (attach == NULL) {
+      fprintf(stderr, "lnsim: %s\n", dlerror());
+      exit(2);
+   }
+   return attach(&lnBus, node);
+}
+
+/************ the run*****************/
+
+static uint32_t rndState;
+
+static uint32_t rnd(uint32_t range){
+   rndState = rndState * 1103515245UL + 12345;
+   return (rndState >> 8) % range;
+}
+
+static int cmpU64(const void *a, const void *b){
+   uint64_t x = *(const uint64_t *)a;
+   uint64_t y = *(const uint64_t *)b;
+   return (x > y) - (x < y);
+}
+
+/* latencies sorted in pLat: p50 p95 p99 max in ms*/
+static void printLat(uint64_t *pLat, uint32_t nr){
+   if (nr == 0) {
+      printf("      -      -      -      -");
+      return;
+   }
+   qsort(pLat, nr, sizeof(pLat[0]), cmpU64);
+   printf(" %6.1f %6.1f %6.1f %6.1f", pLat[nr / 2] / 1e6, pLat[(nr * 95) / 100] / 1e6, pLat[(nr * 99) / 100] / 1e6,
+          pLat[nr - 1] / 1e6);
+}
+
+/* match the 0xE4 UID messages on the wire with the tag arrivals of their node*/
+static void matchArrivals(void){
+   for (uint32_t m = 0; m < wireLogNr; m++) {
+      const lnMsg *pMsg = &wireLog[m].msg;
+      if ((pMsg->data[0] != 0xE4) || (pMsg->data[2] != 0x41)) {
+         continue;
+      }
+      uint8_t uid[UID_LEN];
+      for (uint8_t i = 0; i < UID_LEN; i++) {
+         uid[i] = pMsg->data[LN_UID_HDR_LEN + i] | (((pMsg->data[LN_UID_HDR_LEN + UID_LEN] >> i) & 0x01) << 7);
+      }
+      __simNodeType *n = &nodes[wireLog[m].node];
+      for (uint32_t a = 0; a < n->arrNr; a++) {
+         __simArrivalType *pArr = &n->pArr[a];
+         if ((pArr->latNs == 0) && (pArr->us * 1000 <= wireLog[m].startNs) && (memcmp(pArr->uid, uid, UID_LEN) == 0)) {
+            pArr->latNs = wireLog[m].endNs - pArr->us * 1000;
+            break;
+         }
+      }
+   }
+}
+
+typedef struct {
+   uint8_t  nodes;
+   uint8_t  addr;
+   uint8_t  step;
+   uint8_t  readers;
+   uint32_t seconds;
+   uint32_t periodMs;
+   uint32_t jitterMs;
+   uint32_t dwellMs;
+   uint32_t seed;
+} __simOptType;
+
+static const char *policyName[] = {"legacy", "hash", "queue"};
+
+static void simRun(const char *pLib, const __simOptType *pOpt){
+   const uint8_t ssPins[] = RFID_SS_PINS;
+#if USE_INTERRUPTS
+   const uint8_t irqPins[] = RFID_IRQ_PINS;
+#endif
+   uint64_t endNs = (LNSIM_START_US + (uint64_t)pOpt->seconds * 1000000) * 1000;
+   uint32_t seq = 0;
+
+   nodesNr = pOpt->nodes;
+   rndState = pOpt->seed;
+
+   for (uint8_t k = 0; k < nodesNr; k++) {
+      __simNodeType *n = &nodes[k];
+      const __lnNodeType *pApi = nodeLoad(pLib, k);
+      memset(n, 0, sizeof(*n));
+      n->pApi = pApi;
+      n->addr = pOpt->addr + k * pOpt->step;
+      n->pArr = (__simArrivalType *)calloc(LNSIM_TAGS_MAX, sizeof(__simArrivalType));
+
+      pApi->seed(pOpt->seed * LNSIM_NODES_MAX + k + 1);
+      for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+#if USE_INTERRUPTS
+         pApi->readerAdd(ssPins[i], irqPins[i], RST_PIN);
+#else
+         pApi->readerAdd(ssPins[i], 0xFF, RST_PIN);
+#endif
+         pApi->readerPlug(i, i < pOpt->readers);
+      }
+   }
+
+   /* the bursts: every reader of every node gets a tag within the jitter*/
+   for (uint64_t us = LNSIM_START_US; (us + pOpt->dwellMs * 1000) * 1000 < endNs; us += pOpt->periodMs * 1000) {
+      for (uint8_t k = 0; k < nodesNr; k++) {
+         __simNodeType *n = &nodes[k];
+         for (uint8_t r = 0; (r < pOpt->readers) && (n->arrNr < LNSIM_TAGS_MAX); r++) {
+            __simArrivalType *pArr = &n->pArr[n->arrNr++];
+            uint8_t uid[7];
+            seq++;
+            uid[0] = 0x04; //NXP
+            for (uint8_t i = 1; i < sizeof(uid); i++) {
+               uid[i] = (uint8_t)((seq * 0x9E3779B1UL) >> (i * 3)) ^ (uint8_t)(i * 0x35);
+            }
+            uid[1] = (uint8_t)seq; //unique among the tags of the run
+            uid[2] = (uint8_t)(seq >> 8) | 0x80;
+            uid[3] = (uint8_t)(seq >> 16);
+            pArr->rdr = r;
+            memset(pArr->uid, 0, UID_LEN);
+            memcpy(pArr->uid, uid, min(sizeof(uid), (size_t)UID_LEN));
+            pArr->us = us + (pOpt->jitterMs ? rnd(pOpt->jitterMs * 1000) : 0);
+            pArr->latNs = 0;
+            n->pApi->tagSchedule(pArr->us, r, uid, sizeof(uid), true);
+            n->pApi->tagSchedule(pArr->us + pOpt->dwellMs * 1000, r, uid, sizeof(uid), false);
+         }
+      }
+   }
+
+   /* each node runs to its first bus call*/
+   for (uint8_t k = 0; k < nodesNr; k++) {
+      __simNodeType *n = &nodes[k];
+      getcontext(&n->ctx);
+      n->ctx.uc_stack.ss_sp = malloc(LNSIM_STACK);
+      n->ctx.uc_stack.ss_size = LNSIM_STACK;
+      n->ctx.uc_link = NULL;
+      makecontext(&n->ctx, nodeMain, 0);
+      curNode = k;
+      swapcontext(&schedCtx, &n->ctx);
+   }
+
+   /* the earliest event first; the open group before the calls at the same time*/
+   for (;;) {
+      uint64_t bestNs = UINT64_MAX;
+      uint8_t best = LNSIM_GROUP;
+      if (groupNr > 0) {
+         bestNs = group[0].startNs + senseNs;
+      }
+      for (uint8_t k = 0; k < nodesNr; k++) {
+         if ((nodes[k].state != NODE_TX_WAIT) && (nodes[k].callNs < bestNs)) {
+            bestNs = nodes[k].callNs;
+            best = k;
+         }
+      }
+      if (bestNs >= endNs) {
+         break;
+      }
+      if (best == LNSIM_GROUP) {
+         groupResolve();
+         continue;
+      }
+
+      __simNodeType *n = &nodes[best];
+      if (n->state == NODE_CALL_RX) {
+         n->pRx = wireReceive(n);
+      } else if (n->state == NODE_CALL_TX) {
+         wireAttempt(n);
+         if (n->state == NODE_TX_WAIT) {
+            continue;
+         }
+      }
+      curNode = best;
+      swapcontext(&schedCtx, &n->ctx);
+   }
+
+   matchArrivals();
+
+   printf("policy %s, %u levels: %u nodes, addresses %u..%u step %u, %u readers each\n", policyName[ucPolicy], ucLevels,
+          nodesNr, pOpt->addr, pOpt->addr + (nodesNr - 1) * pOpt->step, pOpt->step, pOpt->readers);
+   printf("  %u s, a burst every %u ms (jitter %u ms, %u ms in the field), sense window %llu us\n", pOpt->seconds,
+          pOpt->periodMs, pOpt->jitterMs, pOpt->dwellMs, (unsigned long long)(senseNs / 1000));
+   printf("  node addr  tags  lost    p50    p95    p99    max (ms)  attempts  collisions\n");
+
+   uint64_t *pAll = (uint64_t *)malloc(nodesNr * LNSIM_TAGS_MAX * sizeof(uint64_t));
+   uint64_t *pLat = (uint64_t *)malloc(LNSIM_TAGS_MAX * sizeof(uint64_t));
+   uint32_t allNr = 0, allArr = 0, allAtt = 0, allColl = 0;
+   for (uint8_t k = 0; k < nodesNr; k++) {
+      __simNodeType *n = &nodes[k];
+      uint32_t latNr = 0;
+      for (uint32_t a = 0; a < n->arrNr; a++) {
+         if (n->pArr[a].latNs != 0) {
+            pLat[latNr++] = n->pArr[a].latNs;
+            pAll[allNr++] = n->pArr[a].latNs;
+         }
+      }
+      printf("  %4u %4u %5u %5u", k, n->addr, n->arrNr, n->arrNr - latNr);
+      printLat(pLat, latNr);
+      printf("  %8u  %5u %4.1f%%\n", n->attempts, n->collisions, n->attempts ? 100.0 * n->collisions / n->attempts : 0.0);
+      allArr += n->arrNr;
+      allAtt += n->attempts;
+      allColl += n->collisions;
+   }
+   printf("   all      %5u %5u", allArr, allArr - allNr);
+   printLat(pAll, allNr);
+   printf("  %8u  %5u %4.1f%%\n", allAtt, allColl, allAtt ? 100.0 * allColl / allAtt : 0.0);
+   fflush(stdout);
+}
+
+int main(int argc, char **argv){
+   __simOptType opt = {8, 1, 10, NR_OF_RFID_PORTS, 20, 1000, 2, 300, 1};
+   int policy = -1;
+   int c;
+
+   while ((c = getopt(argc, argv, "p:n:a:s:l:r:t:b:j:d:w:S:")) != -1) {
+      switch (c) {
+         case 'p':
+            for (policy = 2; (policy >= 0) && (strcmp(optarg, policyName[policy]) != 0); policy--) {
+            }
+            if (policy < 0) {
+               policy = LNSIM_POLICY_BAD;
+            }
+            break;
+         case 'n': opt.nodes = atoi(optarg); break;
+         case 'a': opt.addr = atoi(optarg); break;
+         case 's': opt.step = atoi(optarg); break;
+         case 'l': ucLevels = atoi(optarg); break;
+         case 'r': opt.readers = atoi(optarg); break;
+         case 't': opt.seconds = atoi(optarg); break;
+         case 'b': opt.periodMs = atoi(optarg); break;
+         case 'j': opt.jitterMs = atoi(optarg); break;
+         case 'd': opt.dwellMs = atoi(optarg); break;
+         case 'w': senseNs = atoi(optarg) * 1000ULL; break;
+         case 'S': opt.seed = atoi(optarg); break;
+         default:
+            fprintf(stderr, "usage: %s [-p legacy|hash|queue] [-n nodes] [-a first address] [-s address step] [-l levels]\n"
+                    "       [-r readers] [-t seconds] [-b burst period ms] [-j jitter ms] [-d dwell ms]\n"
+                    "       [-w sense window us] [-S seed]\n", argv[0]);
+            return 2;
+      }
+   }
+   if ((optind < argc) || (opt.nodes == 0) || (opt.nodes > LNSIM_NODES_MAX) || (opt.readers == 0) ||
+       (opt.readers > NR_OF_RFID_PORTS) || (opt.addr == 0) || (opt.addr + (opt.nodes - 1) * opt.step > 0x7F) ||
+       (ucLevels == 0) || (opt.dwellMs >= opt.periodMs) || (policy == LNSIM_POLICY_BAD)) {
+      fprintf(stderr, "lnsim: bad arguments\n");
+      return 2;
+   }
+
+   /* the node library next to the program*/
+   char lib[4096];
+   const char *pSlash = strrchr(argv[0], '/');
+   snprintf(lib, sizeof(lib), "%.*slnsim_node.so", pSlash ? (int)(pSlash - argv[0] + 1) : 0, argv[0]);
+
+   /* one policy, or all of them one after the other; each run in its own process, with new nodes*/
+   for (uint8_t p = 0; p < 3; p++) {
+      if ((policy >= 0) && (p != policy)) {
+         continue;
+      }
+      fflush(stdout);
+      pid_t pid = fork();
+      if (pid == 0) {
+         ucPolicy = p;
+         simRun(lib, &opt);
+         _exit(0);
+      }
+      int status;
+      if ((pid < 0) || (waitpid(pid, &status, 0) != pid) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+         fprintf(stderr, "lnsim: the run of the policy %s failed\n", policyName[p]);
+         return 1;
+      }
+      if (policy < 0) {
+         printf("\n");
+      }
+   }
+   return 0;
+}
@@ -0,0 +1,39 @@
+/*
+ * Multi-node LocoNet bus simulator: the interface between lnsim.cpp (the wire and the
+ * scheduler) and the nodes. Each node is a copy of lnsim_node.so (the sketch, hostsim.cpp,
+ * the stubs and wire_node.cpp) loaded on its own, so it has its own globals and its own
+ * simulated clock. lnsim.cpp gives the bus to the node in lnNodeAttach() and gets back the
+ * functions it drives the node with.
+ */
+#ifndef LNSIM_H_
+#define LNSIM_H_
+
+#include "hostsim.h"
+
+/* the bus, in lnsim.cpp; the node waits in the calls until the wire is known at nowNs*/
+typedef struct {
+   /* one attempt at nowNs; *pEndNs = when the attempt is over (end of the message / break)*/
+   LN_STATUS (*sendTry)(uint8_t node, const lnMsg *pMsg, uint8_t ucPrioDelay, uint64_t nowNs, uint64_t *pEndNs);
+   /* the next message received by the node until nowNs; NULL if none*/
+   const lnMsg *(*receive)(uint8_t node, uint64_t nowNs);
+} __lnBusType;
+
+/* the node, in wire_node.cpp*/
+typedef struct {
+   void (*setup)(void);
+   void (*loop)(void);
+   const uint64_t *pNs;
+   void (*advanceNs)(uint64_t ns);
+   void (*seed)(uint32_t seed);
+   uint8_t (*readerAdd)(uint8_t ssPin, uint8_t irqPin, uint8_t rstPin);
+   void (*readerPlug)(uint8_t rdr, bool bPlugged);
+   void (*tagSchedule)(uint64_t us, uint8_t rdr, const uint8_t *pUid, uint8_t len, bool bEnter);
+   uint8_t (*svRead)(uint16_t offset);
+   void (*svWrite)(uint16_t offset, uint8_t value);
+   void (*reconfigure)(void);
+} __lnNodeType;
+
+#define LN_NODE_ATTACH  "lnNodeAttach"
+typedef const __lnNodeType *(*lnNodeAttachFn)(const __lnBusType *pBus, uint8_t node);
+
+#endif //LNSIM_H_
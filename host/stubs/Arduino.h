@@ -0,0 +1,117 @@
+/*
+ * Host stub of the Arduino core: only what the sketch uses. The time, pin, interrupt and
+ * random functions are implemented by the simulation (hostsim.cpp): micros() / millis()
+ * return the simulated time, which advances with the modelled cost of each call.
+ * The interrupt number of a pin is the pin number.
+ */
+#ifndef HOST_ARDUINO_H_
+#define HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+typedef uint16_t word;
+
+#define HIGH            1
+#define LOW             0
+#define INPUT           0
+#define OUTPUT          1
+#define INPUT_PULLUP    2
+
+#define CHANGE          1
+#define FALLING         2
+#define RISING          3
+
+#define DEC             10
+#define HEX             16
+
+#if defined(ARDUINO_AVR_MEGA2560)
+  #define A0            54
+  #define E2END         0xFFF
+#else
+  #define A0            18
+  #define E2END         0x3FF
+#endif
+#define A1              (A0 + 1)
+#define A2              (A0 + 2)
+#define A3              (A0 + 3)
+#define A4              (A0 + 4)
+#define A5              (A0 + 5)
+
+#define PROGMEM
+#define pgm_read_byte(p)   (*(const uint8_t *)(p))
+#define pgm_read_word(p)   (*(const uint16_t *)(p))
+#define pgm_read_dword(p)  (*(const uint32_t *)(p))
+
+class __FlashStringHelper;
+#define F(s)            (reinterpret_cast<const __FlashStringHelper *>(s))
+
+#ifndef min
+  #define min(a, b)     ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+  #define max(a, b)     ((a) > (b) ? (a) : (b))
+#endif
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+#define digitalPinToInterrupt(p)  (p)
+void attachInterrupt(uint8_t irq, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t irq);
+void noInterrupts(void);
+void interrupts(void);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+/*
+ * Serial: connected unless hostSerialOpen is cleared; the text goes to stdout only with
+ * hostSerialEcho set
+ */
+extern bool hostSerialOpen;
+extern bool hostSerialEcho;
+
+class HardwareSerial {
+public:
+   void begin(unsigned long baud) { (void)baud; }
+   operator bool() { return hostSerialOpen; }
+
+   void print(const __FlashStringHelper *s) { put("%s", (const char *)s); }
+   void print(const char *s) { put("%s", s); }
+   void print(char c) { put("%c", c); }
+   void print(unsigned long n, int base = DEC) { put((base == HEX) ? "%lX" : "%lu", n); }
+   void print(long n, int base = DEC) { put((base == HEX) ? "%lX" : "%ld", n); }
+   void print(unsigned int n, int base = DEC) { print((unsigned long)n, base); }
+   void print(int n, int base = DEC) { print((long)n, base); }
+   void print(unsigned char n, int base = DEC) { print((unsigned long)n, base); }
+   void println(void) { put("%s", "\n"); }
+   template <typename T> void println(T v) { print(v); println(); }
+   template <typename T> void println(T v, int base) { print(v, base); println(); }
+   int available(void) { return 0; }
+   int read(void) { return -1; }
+
+private:
+   template <typename T> void put(const char *fmt, T v) {
+      if (hostSerialEcho) {
+         printf(fmt, v);
+      }
+   }
+};
+
+extern HardwareSerial Serial;
+
+#endif //HOST_ARDUINO_H_
@@ -0,0 +1,33 @@
+/*
+ * Host stub of the EEPROM library. An erased EEPROM (0xFF); a write costs the 3.3 ms of
+ * the AVR EEPROM, like the blocking eeprom_write_byte()
+ */
+#ifndef HOST_EEPROM_H_
+#define HOST_EEPROM_H_
+
+#include <Arduino.h>
+
+#define HOST_EE_WRITE_US  3300
+
+extern uint8_t hostEeprom[E2END + 1];
+extern uint32_t hostEeWrites;
+
+class EEPROMClass {
+public:
+   uint8_t read(int idx) { return hostEeprom[idx & E2END]; }
+   void write(int idx, uint8_t val) {
+      hostEeprom[idx & E2END] = val;
+      hostEeWrites++;
+      delayMicroseconds(HOST_EE_WRITE_US);
+   }
+   void update(int idx, uint8_t val) {
+      if (read(idx) != val) {
+         write(idx, val);
+      }
+   }
+   uint16_t length(void) { return E2END + 1; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif //HOST_EEPROM_H_
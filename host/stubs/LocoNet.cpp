@@ -0,0 +1,59 @@
+/*
+ * Host stub of the LocoNet library (mrrwa): LocoNet.send() retries the attempts as the
+ * library does; the SV storage is the EEPROM, SV n at EEPROM[n - 2] as in the library
+ */
+#include <EEPROM.h>
+#include <LocoNet.h>
+#include <utility/ln_sw_uart.h>
+#include "../hostsim.h"
+
+lnMsg *LocoNetClass::receive(void){
+   return hostLnReceive();
+}
+
+LN_STATUS LocoNetClass::send(lnMsg *pPacket){
+   return send(pPacket, LN_BACKOFF_INITIAL);
+}
+
+LN_STATUS LocoNetClass::send(lnMsg *pPacket, uint8_t ucPrioDelay){
+   LN_STATUS enReturn = LN_UNKNOWN_ERROR;
+
+   for (uint8_t ucTry = 0; ucTry < LN_TX_RETRIES_MAX; ucTry++) {
+      /* wait previous traffic and the priority delay*/
+      do {
+         enReturn = sendLocoNetPacketTry(pPacket, ucPrioDelay);
+         if (enReturn == LN_DONE) {
+            return enReturn;
+         }
+      } while ((enReturn == LN_CD_BACKOFF) || (enReturn == LN_PRIO_BACKOFF) || (enReturn == LN_NETWORK_BUSY));
+      if (ucPrioDelay > LN_BACKOFF_MIN) {
+         ucPrioDelay--;
+      }
+   }
+   return LN_RETRY_ERROR;
+}
+
+void LocoNetSystemVariableClass::init(uint8_t newMfgId, uint8_t newDevId, uint16_t newProductId, uint8_t newSwVersion){
+   (void)newMfgId;
+   (void)newDevId;
+   (void)newProductId;
+   swVersion = newSwVersion;
+}
+
+uint8_t LocoNetSystemVariableClass::readSVStorage(uint16_t Offset){
+   if (Offset == SV_ADDR_EEPROM_SIZE) {
+      return (E2END + 1) >> 8;
+   }
+   if (Offset == SV_ADDR_SW_VERSION) {
+      return swVersion;
+   }
+   return EEPROM.read(Offset - 2);
+}
+
+uint8_t LocoNetSystemVariableClass::writeSVStorage(uint16_t Offset, uint8_t Value){
+   Offset -= 2;
+   if (EEPROM.read(Offset) != Value) {
+      EEPROM.write(Offset, Value);
+   }
+   return EEPROM.read(Offset);
+}
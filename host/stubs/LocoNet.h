@@ -0,0 +1,65 @@
+/*
+ * Host stub of the LocoNet library (mrrwa): the opcodes, types and classes used by the
+ * sketch. The software UART part (sendLocoNetPacketTry) is in utility/ln_sw_uart.h; the
+ * bus behind it is given by the host program (hostLnSendTry() / hostLnReceive())
+ */
+#ifndef HOST_LOCONET_H_
+#define HOST_LOCONET_H_
+
+#include <Arduino.h>
+
+#define OPC_SW_REQ          0xB0
+#define OPC_SW_REP          0xB1
+#define OPC_INPUT_REP       0xB2
+#define OPC_LONG_ACK        0xB4
+#define OPC_SW_STATE        0xBC
+#define OPC_MULTI_SENSE     0xD0
+#define OPC_PEER_XFER       0xE5
+
+#define LN_TX_RETRIES_MAX   25
+
+#define SV_ADDR_EEPROM_SIZE      1
+#define SV_ADDR_SW_VERSION       2
+#define SV_ADDR_NODE_ID_L        3
+#define SV_ADDR_NODE_ID_H        4
+#define SV_ADDR_SERIAL_NUMBER_L  5
+#define SV_ADDR_SERIAL_NUMBER_H  6
+#define SV_ADDR_USER_BASE        7
+
+typedef enum {
+   LN_CD_BACKOFF = 0, LN_PRIO_BACKOFF, LN_NETWORK_BUSY, LN_DONE, LN_COLLISION, LN_UNKNOWN_ERROR, LN_RETRY_ERROR
+} LN_STATUS;
+
+typedef enum {
+   SV_OK = 0, SV_ERROR = 1, SV_DEFERRED_PROCESSING_NEEDED = 2
+} SV_STATUS;
+
+typedef union {
+   uint8_t data[16];
+} lnMsg;
+
+inline uint8_t getLnMsgSize(volatile lnMsg *Msg){
+   return ((Msg->data[0] & 0x60) == 0x60) ? Msg->data[1] : ((Msg->data[0] & 0x60) >> 4) + 2;
+}
+
+class LocoNetClass {
+public:
+   void init(uint8_t txPin) { (void)txPin; }
+   lnMsg *receive(void);
+   LN_STATUS send(lnMsg *TxPacket);
+   LN_STATUS send(lnMsg *TxPacket, uint8_t PrioDelay);
+};
+
+extern LocoNetClass LocoNet;
+
+class LocoNetSystemVariableClass {
+public:
+   void init(uint8_t newMfgId, uint8_t newDevId, uint16_t newProductId, uint8_t newSwVersion);
+   uint8_t readSVStorage(uint16_t Offset);
+   uint8_t writeSVStorage(uint16_t Offset, uint8_t Value);
+
+private:
+   uint8_t swVersion;
+};
+
+#endif //HOST_LOCONET_H_
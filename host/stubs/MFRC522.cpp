@@ -0,0 +1,391 @@
+/*
+ * Host stub of the MFRC522 library. The register access and the PICC commands follow the
+ * library code (1.4.x), so the reader model of hostsim.cpp sees the same SPI traffic
+ */
+#include <MFRC522.h>
+
+#define UNUSED_PIN  0xFF
+
+MFRC522::MFRC522() : MFRC522(UNUSED_PIN, UNUSED_PIN) {
+}
+
+MFRC522::MFRC522(byte chipSelectPin, byte resetPowerDownPin) {
+   _chipSelectPin = chipSelectPin;
+   _resetPowerDownPin = resetPowerDownPin;
+   memset(&uid, 0, sizeof(uid));
+}
+
+void MFRC522::PCD_WriteRegister(PCD_Register reg, byte value){
+   SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));
+   digitalWrite(_chipSelectPin, LOW);
+   SPI.transfer(reg);
+   SPI.transfer(value);
+   digitalWrite(_chipSelectPin, HIGH);
+   SPI.endTransaction();
+}
+
+void MFRC522::PCD_WriteRegister(PCD_Register reg, byte count, byte *values){
+   SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));
+   digitalWrite(_chipSelectPin, LOW);
+   SPI.transfer(reg);
+   for (byte index = 0; index < count; index++) {
+      SPI.transfer(values[index]);
+   }
+   digitalWrite(_chipSelectPin, HIGH);
+   SPI.endTransaction();
+}
+
+byte MFRC522::PCD_ReadRegister(PCD_Register reg){
+   byte value;
+
+   SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));
+   digitalWrite(_chipSelectPin, LOW);
+   SPI.transfer(0x80 | reg);
+   value = SPI.transfer(0);
+   digitalWrite(_chipSelectPin, HIGH);
+   SPI.endTransaction();
+   return value;
+}
+
+void MFRC522::PCD_ReadRegister(PCD_Register reg, byte count, byte *values, byte rxAlign){
+   if (count == 0) {
+      return;
+   }
+   byte address = 0x80 | reg;
+   byte index = 0;
+
+   SPI.beginTransaction(SPISettings(MFRC522_SPICLOCK, MSBFIRST, SPI_MODE0));
+   digitalWrite(_chipSelectPin, LOW);
+   count--;
+   SPI.transfer(address);
+   if (rxAlign) { //only the bit positions rxAlign..7 of values[0] are updated
+      byte mask = (0xFF << rxAlign) & 0xFF;
+      byte value = SPI.transfer(address);
+      values[0] = (values[0] & ~mask) | (value & mask);
+      index++;
+   }
+   while (index < count) {
+      values[index] = SPI.transfer(address);
+      index++;
+   }
+   values[index] = SPI.transfer(0);
+   digitalWrite(_chipSelectPin, HIGH);
+   SPI.endTransaction();
+}
+
+void MFRC522::PCD_SetRegisterBitMask(PCD_Register reg, byte mask){
+   byte tmp = PCD_ReadRegister(reg);
+   PCD_WriteRegister(reg, tmp | mask);
+}
+
+void MFRC522::PCD_ClearRegisterBitMask(PCD_Register reg, byte mask){
+   byte tmp = PCD_ReadRegister(reg);
+   PCD_WriteRegister(reg, tmp & (~mask));
+}
+
+MFRC522::StatusCode MFRC522::PCD_CalculateCRC(byte *data, byte length, byte *result){
+   PCD_WriteRegister(CommandReg, PCD_Idle);
+   PCD_WriteRegister(DivIrqReg, 0x04);     //clear the CRCIRq bit
+   PCD_WriteRegister(FIFOLevelReg, 0x80);  //flush the FIFO
+   PCD_WriteRegister(FIFODataReg, length, data);
+   PCD_WriteRegister(CommandReg, PCD_CalcCRC);
+
+   const uint32_t deadline = millis() + 89;
+   do {
+      byte n = PCD_ReadRegister(DivIrqReg);
+      if (n & 0x04) { //CRCIRq: calculation done
+         PCD_WriteRegister(CommandReg, PCD_Idle);
+         result[0] = PCD_ReadRegister(CRCResultRegL);
+         result[1] = PCD_ReadRegister(CRCResultRegH);
+         return STATUS_OK;
+      }
+   } while ((int32_t)(millis() - deadline) < 0);
+   return STATUS_TIMEOUT;
+}
+
+void MFRC522::PCD_Init(){
+   bool hardReset = false;
+
+   pinMode(_chipSelectPin, OUTPUT);
+   digitalWrite(_chipSelectPin, HIGH);
+
+   if (_resetPowerDownPin != UNUSED_PIN) {
+      pinMode(_resetPowerDownPin, INPUT);
+      if (digitalRead(_resetPowerDownPin) == LOW) { //the chip is in power down mode
+         pinMode(_resetPowerDownPin, OUTPUT);
+         digitalWrite(_resetPowerDownPin, LOW);
+         delayMicroseconds(2);
+         digitalWrite(_resetPowerDownPin, HIGH);
+         delay(50); //oscillator start-up
+         hardReset = true;
+      }
+   }
+   if (!hardReset) {
+      PCD_Reset();
+   }
+
+   PCD_WriteRegister(TxModeReg, 0x00);
+   PCD_WriteRegister(RxModeReg, 0x00);
+   PCD_WriteRegister(ModWidthReg, 0x26);
+   PCD_WriteRegister(TModeReg, 0x80);      //TAuto: 25 ms timeout of the communication with the PICC
+   PCD_WriteRegister(TPrescalerReg, 0xA9);
+   PCD_WriteRegister(TReloadRegH, 0x03);
+   PCD_WriteRegister(TReloadRegL, 0xE8);
+   PCD_WriteRegister(TxASKReg, 0x40);      //100 % ASK
+   PCD_WriteRegister(ModeReg, 0x3D);       //CRC preset 0x6363
+   PCD_AntennaOn();
+}
+
+void MFRC522::PCD_Init(byte chipSelectPin, byte resetPowerDownPin){
+   _chipSelectPin = chipSelectPin;
+   _resetPowerDownPin = resetPowerDownPin;
+   PCD_Init();
+}
+
+void MFRC522::PCD_Reset(){
+   PCD_WriteRegister(CommandReg, PCD_SoftReset);
+   uint8_t count = 0;
+   do {
+      delay(50);
+   } while ((PCD_ReadRegister(CommandReg) & (1 << 4)) && ((++count) < 3)); //PowerDown bit
+}
+
+void MFRC522::PCD_AntennaOn(){
+   byte value = PCD_ReadRegister(TxControlReg);
+   if ((value & 0x03) != 0x03) {
+      PCD_WriteRegister(TxControlReg, value | 0x03);
+   }
+}
+
+MFRC522::StatusCode MFRC522::PCD_TransceiveData(byte *sendData, byte sendLen, byte *backData, byte *backLen,
+                                                byte *validBits, byte rxAlign, bool checkCRC){
+   byte waitIRq = 0x30; //RxIRq and IdleIRq
+   return PCD_CommunicateWithPICC(PCD_Transceive, waitIRq, sendData, sendLen, backData, backLen, validBits, rxAlign, checkCRC);
+}
+
+MFRC522::StatusCode MFRC522::PCD_CommunicateWithPICC(byte command, byte waitIRq, byte *sendData, byte sendLen,
+                                                     byte *backData, byte *backLen, byte *validBits,
+                                                     byte rxAlign, bool checkCRC){
+   byte txLastBits = validBits ? *validBits : 0;
+   byte bitFraming = (rxAlign << 4) + txLastBits;
+
+   PCD_WriteRegister(CommandReg, PCD_Idle);
+   PCD_WriteRegister(ComIrqReg, 0x7F);
+   PCD_WriteRegister(FIFOLevelReg, 0x80);
+   PCD_WriteRegister(FIFODataReg, sendLen, sendData);
+   PCD_WriteRegister(BitFramingReg, bitFraming);
+   PCD_WriteRegister(CommandReg, command);
+   if (command == PCD_Transceive) {
+      PCD_SetRegisterBitMask(BitFramingReg, 0x80); //StartSend
+   }
+
+   const uint32_t deadline = millis() + 36;
+   bool completed = false;
+   do {
+      byte n = PCD_ReadRegister(ComIrqReg);
+      if (n & waitIRq) {
+         completed = true;
+         break;
+      }
+      if (n & 0x01) { //TimerIRq: nothing received in 25 ms
+         return STATUS_TIMEOUT;
+      }
+   } while ((int32_t)(millis() - deadline) < 0);
+   if (!completed) {
+      return STATUS_TIMEOUT;
+   }
+
+   byte errorRegValue = PCD_ReadRegister(ErrorReg);
+   if (errorRegValue & 0x13) { //BufferOvfl ParityErr ProtocolErr
+      return STATUS_ERROR;
+   }
+
+   byte _validBits = 0;
+   if (backData && backLen) {
+      byte n = PCD_ReadRegister(FIFOLevelReg);
+      if (n > *backLen) {
+         return STATUS_NO_ROOM;
+      }
+      *backLen = n;
+      PCD_ReadRegister(FIFODataReg, n, backData, rxAlign);
+      _validBits = PCD_ReadRegister(ControlReg) & 0x07;
+      if (validBits) {
+         *validBits = _validBits;
+      }
+   }
+
+   if (errorRegValue & 0x08) { //CollErr
+      return STATUS_COLLISION;
+   }
+
+   if (backData && backLen && checkCRC) {
+      if ((*backLen == 1) && (_validBits == 4)) {
+         return STATUS_MIFARE_NACK;
+      }
+      if ((*backLen < 2) || (_validBits != 0)) {
+         return STATUS_CRC_WRONG;
+      }
+      byte controlBuffer[2];
+      StatusCode status = PCD_CalculateCRC(&backData[0], *backLen - 2, &controlBuffer[0]);
+      if (status != STATUS_OK) {
+         return status;
+      }
+      if ((backData[*backLen - 2] != controlBuffer[0]) || (backData[*backLen - 1] != controlBuffer[1])) {
+         return STATUS_CRC_WRONG;
+      }
+   }
+   return STATUS_OK;
+}
+
+MFRC522::StatusCode MFRC522::PICC_HaltA(){
+   byte buffer[4];
+
+   buffer[0] = PICC_CMD_HLTA;
+   buffer[1] = 0;
+   StatusCode result = PCD_CalculateCRC(buffer, 2, &buffer[2]);
+   if (result != STATUS_OK) {
+      return result;
+   }
+   /* the PICC does not answer a HLTA: a timeout is the success*/
+   result = PCD_TransceiveData(buffer, sizeof(buffer), NULL, 0);
+   if (result == STATUS_TIMEOUT) {
+      return STATUS_OK;
+   }
+   if (result == STATUS_OK) {
+      return STATUS_ERROR;
+   }
+   return result;
+}
+
+/*
+ * Anticollision and select, cascade level by cascade level (ISO/IEC 14443-3). Only the
+ * validBits == 0 case of the library is kept: the sketch never passes known UID bits
+ */
+MFRC522::StatusCode MFRC522::PICC_Select(Uid *uid, byte validBits){
+   bool uidComplete = false;
+   byte cascadeLevel = 1;
+   byte buffer[9];     //SEL NVB UID0..3 BCC CRC_A
+   byte bufferUsed;
+   byte rxAlign;
+   byte txLastBits;
+   byte *responseBuffer;
+   byte responseLength;
+   byte uidIndex;
+   StatusCode result;
+
+   if (validBits != 0) {
+      return STATUS_INVALID;
+   }
+
+   while (!uidComplete) {
+      bool useCascadeTag;
+      switch (cascadeLevel) {
+         case 1:
+            buffer[0] = PICC_CMD_SEL_CL1;
+            uidIndex = 0;
+            break;
+         case 2:
+            buffer[0] = PICC_CMD_SEL_CL2;
+            uidIndex = 3;
+            break;
+         case 3:
+            buffer[0] = PICC_CMD_SEL_CL3;
+            uidIndex = 6;
+            break;
+         default:
+            return STATUS_INTERNAL_ERROR;
+      }
+      useCascadeTag = false; //the cascade tag is known only after the first answer
+
+      int8_t currentLevelKnownBits = 0;
+      bool selectDone = false;
+      PCD_ClearRegisterBitMask(CollReg, 0x80); //ValuesAfterColl: all the bits are cleared after a collision
+
+      while (!selectDone) {
+         if (currentLevelKnownBits >= 32) { //all the UID bits of the level are known => SELECT
+            buffer[1] = 0x70;
+            buffer[6] = buffer[2] ^ buffer[3] ^ buffer[4] ^ buffer[5];
+            result = PCD_CalculateCRC(buffer, 7, &buffer[7]);
+            if (result != STATUS_OK) {
+               return result;
+            }
+            txLastBits = 0;
+            bufferUsed = 9;
+            responseBuffer = &buffer[6]; //SAK and CRC_A
+            responseLength = 3;
+         } else { //ANTICOLLISION
+            txLastBits = currentLevelKnownBits % 8;
+            byte count = currentLevelKnownBits / 8;
+            byte index = 2 + count;
+            buffer[1] = (index << 4) + txLastBits; //NVB
+            bufferUsed = index + (txLastBits ? 1 : 0);
+            responseBuffer = &buffer[index];
+            responseLength = sizeof(buffer) - index;
+         }
+
+         rxAlign = txLastBits;
+         PCD_WriteRegister(BitFramingReg, (rxAlign << 4) + txLastBits);
+
+         result = PCD_TransceiveData(buffer, bufferUsed, responseBuffer, &responseLength, &txLastBits, rxAlign);
+         if (result == STATUS_COLLISION) { //more tags answered
+            byte valueOfCollReg = PCD_ReadRegister(CollReg);
+            if (valueOfCollReg & 0x20) { //CollPosNotValid
+               return STATUS_COLLISION;
+            }
+            byte collisionPos = valueOfCollReg & 0x1F; //0 => bit 32
+            if (collisionPos == 0) {
+               collisionPos = 32;
+            }
+            if (collisionPos <= currentLevelKnownBits) {
+               return STATUS_INTERNAL_ERROR;
+            }
+            /* the tag with the collision bit set wins*/
+            currentLevelKnownBits = collisionPos;
+            byte count = currentLevelKnownBits % 8;
+            byte checkBit = (currentLevelKnownBits - 1) % 8;
+            byte index = 1 + (currentLevelKnownBits / 8) + (count ? 1 : 0);
+            buffer[index] |= (1 << checkBit);
+         } else if (result != STATUS_OK) {
+            return result;
+         } else {
+            if (currentLevelKnownBits >= 32) { //SELECT answered
+               selectDone = true;
+            } else {
+               currentLevelKnownBits = 32;
+            }
+         }
+      }
+
+      /* the UID bytes of this level*/
+      useCascadeTag = (buffer[2] == PICC_CMD_CT);
+      byte index = useCascadeTag ? 3 : 2;
+      byte bytesToCopy = useCascadeTag ? 3 : 4;
+      for (byte count = 0; count < bytesToCopy; count++) {
+         uid->uidByte[uidIndex + count] = buffer[index++];
+      }
+
+      if ((responseLength != 3) || (txLastBits != 0)) { //SAK must be exactly 24 bits
+         return STATUS_ERROR;
+      }
+      result = PCD_CalculateCRC(responseBuffer, 1, &buffer[2]);
+      if (result != STATUS_OK) {
+         return result;
+      }
+      if ((buffer[2] != responseBuffer[1]) || (buffer[3] != responseBuffer[2])) {
+         return STATUS_CRC_WRONG;
+      }
+      if (responseBuffer[0] & 0x04) { //cascade bit set => UID not complete
+         cascadeLevel++;
+      } else {
+         uidComplete = true;
+         uid->sak = responseBuffer[0];
+      }
+   }
+
+   uid->size = 3 * cascadeLevel + 1;
+   return STATUS_OK;
+}
+
+bool MFRC522::PICC_ReadCardSerial(){
+   return PICC_Select(&uid) == STATUS_OK;
+}
@@ -0,0 +1,84 @@
+/*
+ * Host stub of the MFRC522 library (miguelbalboa/rfid): the subset used by the sketch,
+ * with the same register traffic as the library, so the SPI counters of the host build
+ * include the UID reading (anticollision / select) done by the library
+ */
+#ifndef HOST_MFRC522_H_
+#define HOST_MFRC522_H_
+
+#include <Arduino.h>
+#include <SPI.h>
+
+#define MFRC522_SPICLOCK  4000000u  /* SPI_CLOCK_DIV4 at 16 MHz*/
+
+class MFRC522 {
+public:
+   enum PCD_Register : byte {
+      CommandReg = 0x01 << 1, ComIEnReg = 0x02 << 1, DivIEnReg = 0x03 << 1, ComIrqReg = 0x04 << 1,
+      DivIrqReg = 0x05 << 1, ErrorReg = 0x06 << 1, Status1Reg = 0x07 << 1, Status2Reg = 0x08 << 1,
+      FIFODataReg = 0x09 << 1, FIFOLevelReg = 0x0A << 1, WaterLevelReg = 0x0B << 1, ControlReg = 0x0C << 1,
+      BitFramingReg = 0x0D << 1, CollReg = 0x0E << 1,
+      ModeReg = 0x11 << 1, TxModeReg = 0x12 << 1, RxModeReg = 0x13 << 1, TxControlReg = 0x14 << 1,
+      TxASKReg = 0x15 << 1, TxSelReg = 0x16 << 1, RxSelReg = 0x17 << 1, RxThresholdReg = 0x18 << 1,
+      DemodReg = 0x19 << 1, MfTxReg = 0x1C << 1, MfRxReg = 0x1D << 1, SerialSpeedReg = 0x1F << 1,
+      CRCResultRegH = 0x21 << 1, CRCResultRegL = 0x22 << 1, ModWidthReg = 0x24 << 1, RFCfgReg = 0x26 << 1,
+      GsNReg = 0x27 << 1, CWGsPReg = 0x28 << 1, ModGsPReg = 0x29 << 1, TModeReg = 0x2A << 1,
+      TPrescalerReg = 0x2B << 1, TReloadRegH = 0x2C << 1, TReloadRegL = 0x2D << 1,
+      TCounterValueRegH = 0x2E << 1, TCounterValueRegL = 0x2F << 1, VersionReg = 0x37 << 1
+   };
+
+   enum PCD_Command : byte {
+      PCD_Idle = 0x00, PCD_Mem = 0x01, PCD_GenerateRandomID = 0x02, PCD_CalcCRC = 0x03,
+      PCD_Transmit = 0x04, PCD_NoCmdChange = 0x07, PCD_Receive = 0x08, PCD_Transceive = 0x0C,
+      PCD_MFAuthent = 0x0E, PCD_SoftReset = 0x0F
+   };
+
+   enum PICC_Command : byte {
+      PICC_CMD_REQA = 0x26, PICC_CMD_WUPA = 0x52, PICC_CMD_CT = 0x88, PICC_CMD_SEL_CL1 = 0x93,
+      PICC_CMD_SEL_CL2 = 0x95, PICC_CMD_SEL_CL3 = 0x97, PICC_CMD_HLTA = 0x50
+   };
+
+   enum StatusCode : byte {
+      STATUS_OK, STATUS_ERROR, STATUS_COLLISION, STATUS_TIMEOUT, STATUS_NO_ROOM,
+      STATUS_INTERNAL_ERROR, STATUS_INVALID, STATUS_CRC_WRONG, STATUS_MIFARE_NACK = 0xff
+   };
+
+   typedef struct {
+      byte size;
+      byte uidByte[10];
+      byte sak;
+   } Uid;
+
+   Uid uid;
+
+   MFRC522();
+   MFRC522(byte chipSelectPin, byte resetPowerDownPin);
+
+   void PCD_WriteRegister(PCD_Register reg, byte value);
+   void PCD_WriteRegister(PCD_Register reg, byte count, byte *values);
+   byte PCD_ReadRegister(PCD_Register reg);
+   void PCD_ReadRegister(PCD_Register reg, byte count, byte *values, byte rxAlign = 0);
+   void PCD_SetRegisterBitMask(PCD_Register reg, byte mask);
+   void PCD_ClearRegisterBitMask(PCD_Register reg, byte mask);
+   StatusCode PCD_CalculateCRC(byte *data, byte length, byte *result);
+
+   void PCD_Init();
+   void PCD_Init(byte chipSelectPin, byte resetPowerDownPin);
+   void PCD_Reset();
+   void PCD_AntennaOn();
+
+   StatusCode PCD_TransceiveData(byte *sendData, byte sendLen, byte *backData, byte *backLen,
+                                 byte *validBits = NULL, byte rxAlign = 0, bool checkCRC = false);
+   StatusCode PCD_CommunicateWithPICC(byte command, byte waitIRq, byte *sendData, byte sendLen,
+                                      byte *backData = NULL, byte *backLen = NULL, byte *validBits = NULL,
+                                      byte rxAlign = 0, bool checkCRC = false);
+   StatusCode PICC_HaltA();
+   StatusCode PICC_Select(Uid *uid, byte validBits = 0);
+   bool PICC_ReadCardSerial();
+
+private:
+   byte _chipSelectPin;
+   byte _resetPowerDownPin;
+};
+
+#endif //HOST_MFRC522_H_
@@ -0,0 +1,36 @@
+/*
+ * Host stub of the SPI library. The bytes go to the simulated reader whose SS pin is low
+ * (hostsim.cpp); each byte costs the bus time at the clock of the open transaction.
+ */
+#ifndef HOST_SPI_H_
+#define HOST_SPI_H_
+
+#include <Arduino.h>
+
+#define MSBFIRST        1
+#define LSBFIRST        0
+#define SPI_MODE0       0x00
+
+class SPISettings {
+public:
+   SPISettings() : clock(4000000) {}
+   SPISettings(uint32_t ulClock, uint8_t bitOrder, uint8_t dataMode) : clock(ulClock) {
+      (void)bitOrder;
+      (void)dataMode;
+   }
+   uint32_t clock;
+};
+
+class SPIClass {
+public:
+   void begin(void);
+   void end(void) {}
+   void beginTransaction(SPISettings settings);
+   void endTransaction(void);
+   uint8_t transfer(uint8_t data);
+   void transfer(void *buf, size_t count);
+};
+
+extern SPIClass SPI;
+
+#endif //HOST_SPI_H_
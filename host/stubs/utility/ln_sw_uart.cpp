@@ -0,0 +1,20 @@
+/*
+ * Host stub of the LocoNet library software UART: the checksum is set as in the library,
+ * the attempt itself is done by the bus of the host program
+ */
+#include <utility/ln_sw_uart.h>
+#include "../../hostsim.h"
+
+LN_STATUS sendLocoNetPacketTry(lnMsg *TxData, unsigned char ucPrioDelay){
+   uint8_t len = getLnMsgSize(TxData);
+   uint8_t checkSum = 0xFF;
+
+   for (uint8_t i = 0; i < len - 1; i++) {
+      checkSum ^= TxData->data[i];
+   }
+   TxData->data[len - 1] = checkSum;
+   if (ucPrioDelay > LN_BACKOFF_MAX) {
+      ucPrioDelay = LN_BACKOFF_MAX;
+   }
+   return hostLnSendTry(TxData, ucPrioDelay);
+}
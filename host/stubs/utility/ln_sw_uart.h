@@ -0,0 +1,22 @@
+/*
+ * Host stub of the LocoNet library software UART: the backoff timing (bit times) and the
+ * non blocking send attempt
+ */
+#ifndef HOST_LN_SW_UART_H_
+#define HOST_LN_SW_UART_H_
+
+#include <LocoNet.h>
+
+#define LN_BIT_US             60  /* 16.66 kBd*/
+
+#define LN_CARRIER_TICKS      20  /* carrier detect backoff - all devices have to wait this*/
+#define LN_MASTER_DELAY        6  /* non master devices have to wait this additionally*/
+#define LN_INITIAL_PRIO_DELAY 20  /* initial attempt adds priority delay*/
+#define LN_BACKOFF_MIN        (LN_CARRIER_TICKS + LN_MASTER_DELAY)
+#define LN_BACKOFF_INITIAL    (LN_BACKOFF_MIN + LN_INITIAL_PRIO_DELAY)
+#define LN_BACKOFF_MAX        (LN_BACKOFF_INITIAL + 10)
+#define LN_COLLISION_TICKS    15  /* break sent after a collision*/
+
+LN_STATUS sendLocoNetPacketTry(lnMsg *TxData, unsigned char ucPrioDelay);
+
+#endif //HOST_LN_SW_UART_H_
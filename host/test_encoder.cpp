@@ -0,0 +1,63 @@
+/*
+ * UID encoder: the 0xE4 message built by buildLnMessage() byte for byte against the wire
+ * format of the README, for the sensor address range and the 4 / 7 / 10 byte UIDs
+ */
+#include "hosttest.h"
+
+typedef struct {
+   uint16_t senAddr;
+   uint8_t  uidLen;
+   uint8_t  uid[10];
+   uint8_t  msg[14];
+} __vectorType;
+
+/* 0xE4 0x0E 0x41 <ADDR_H> <ADDR_L> <UID0_LSB> .. <UID6_LSB> <UID_MSBS> <CHK_SUMM>*/
+static const __vectorType vectors[] = {
+   {1, 7, {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66},
+    {0xE4, 0x0E, 0x41, 0x00, 0x01, 0x04, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x2A, 0x0C}},
+   {1000, 4, {0xDE, 0xAD, 0x7E, 0x01}, //padded with 0
+    {0xE4, 0x0E, 0x41, 0x07, 0x68, 0x5E, 0x2D, 0x7E, 0x01, 0x00, 0x00, 0x00, 0x03, 0x34}},
+   {4095, 10, {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}, //the first 7 bytes
+    {0xE4, 0x0E, 0x41, 0x1F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x7F, 0x34}},
+};
+
+/* the sensor address of the port in the LocoIO SVs (Rocrail codification), then recalculated*/
+static void setSenAddr(uint8_t port, uint16_t senAddr){
+   uint16_t n = senAddr - 1;
+
+   svWrite(SV_ADDR_USER_BASE + 3 + 3 * port + 1, (n >> 1) & 0x7F);
+   svWrite(SV_ADDR_USER_BASE + 3 + 3 * port + 2, ((n >> 8) & 0x0F) | ((n & 0x01) << 5));
+   calcSenAddr(port);
+}
+
+int main(void){
+   testBoot(2);
+
+   for (uint8_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+      const __vectorType *pV = &vectors[v];
+      MFRC522::Uid uid;
+      lnMsg msg;
+
+      for (uint8_t port = 0; port < 2; port++) {
+         setSenAddr(port, pV->senAddr);
+         CHECK(rfidPorts[port].addrSenFull == pV->senAddr);
+         memset(&uid, 0, sizeof(uid));
+         uid.size = pV->uidLen;
+         memcpy(uid.uidByte, pV->uid, pV->uidLen);
+         memset(&msg, 0xAA, sizeof(msg));
+         buildLnMessage(uid, port, &msg);
+         CHECK(memcmp(msg.data, pV->msg, sizeof(pV->msg)) == 0);
+         CHECK((msg.data[14] == 0xAA) && (msg.data[15] == 0xAA)); //nothing written after the message
+      }
+   }
+
+   /* on the bus: the tag read by the reader of the port with the address 1000*/
+   const __vectorType *pV = &vectors[1];
+   uint32_t from = hostLnLogNr;
+   setSenAddr(1, pV->senAddr);
+   hostTagEnter(1, pV->uid, pV->uidLen);
+   testRunUs(50000);
+   CHECK(testFindMsg(from, pV->msg, sizeof(pV->msg)) >= 0);
+
+   return testResult("test_encoder");
+}
@@ -0,0 +1,50 @@
+/*
+ * Reader health check: a reader losing its configuration is reported failed, reset and
+ * reported recovered, without any loop() pass waiting for the end of its reset
+ */
+#include "hosttest.h"
+
+static const uint8_t uidA[7] = {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66};
+
+static uint64_t maxPassUs = 0;
+
+/* like testRunUs(), with the longest loop() pass*/
+static void runUs(uint64_t us){
+   uint64_t end = hostUs() + us;
+   while (hostUs() < end) {
+      hostAdvanceUs(HOST_LOOP_US);
+      uint64_t start = hostUs();
+      loop();
+      if (hostUs() - start > maxPassUs) {
+         maxPassUs = hostUs() - start;
+      }
+   }
+}
+
+int main(void){
+   uint8_t msgUid[LN_UID_HDR_LEN + UID_LEN + 1];
+
+   testBoot(2);
+   testUidMsg(0, uidA, sizeof(uidA), msgUid);
+   const uint8_t msgFailed[] = {0xE4, LN_HEALTH_LEN, LN_HEALTH_TYPE, rfidPorts[0].addrHiSen, rfidPorts[0].addrLoSen, HEALTH_FAILED};
+   const uint8_t msgRecovered[] = {0xE4, LN_HEALTH_LEN, LN_HEALTH_TYPE, rfidPorts[0].addrHiSen, rfidPorts[0].addrLoSen, HEALTH_RECOVERED};
+
+   /* brown-out of reader 0: antenna off; failed at the next check, back after the reset*/
+   uint32_t from = hostLnLogNr;
+   uint32_t resets = stats.reader[0].resets;
+   hostReaderGlitch(0);
+   runUs(2 * HEALTH_PERIOD_DEF * 100000UL + 200000);
+   int idxFailed = testFindMsg(from, msgFailed, sizeof(msgFailed));
+   int idxRecovered = testFindMsg(from, msgRecovered, sizeof(msgRecovered));
+   CHECK((idxFailed >= 0) && (idxRecovered > idxFailed));
+   CHECK(rfidPorts[0].bActive && !rfidPorts[0].bFailed && (stats.reader[0].resets == resets + 1));
+   CHECK(maxPassUs < 1000UL * RFID_RESET_MS / 2);
+
+   /* the reader reads tags again*/
+   from = hostLnLogNr;
+   hostTagEnter(0, uidA, sizeof(uidA));
+   runUs(100000);
+   CHECK(testFindMsg(from, msgUid, sizeof(msgUid)) >= 0);
+
+   return testResult("test_health");
+}
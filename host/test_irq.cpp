@@ -0,0 +1,112 @@
+/*
+ * Interrupt mode (USE_INTERRUPTS): the tags are detected by the reader IRQ, the idle loop
+ * doesn't poll the readers, a tag is reported once, with the time of its IRQ, and its port
+ * freed after it left
+ */
+#include "hosttest.h"
+
+#if !USE_INTERRUPTS
+  #error "test_irq is built with USE_INTERRUPTS=1"
+#endif
+
+static const uint8_t uidA[7] = {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66};
+static const uint8_t uidB[7] = {0x04, 0x17, 0xE8, 0x39, 0x4A, 0x5B, 0xEC};
+static const uint8_t uidC[4] = {0xDE, 0xAD, 0x7E, 0x01};
+
+/* a tag enters the reader: reported by one 0xE4 message within the rearm period*/
+static int tagReported(uint8_t rdr, const uint8_t *pUid, uint8_t len){
+   uint8_t msg[LN_UID_HDR_LEN + UID_LEN + 1];
+   uint32_t irqs = hostCnt.irqs;
+   uint32_t from = hostLnLogNr;
+   uint64_t t0 = hostUs();
+
+   testUidMsg(rdr, pUid, len, msg);
+   hostTagEnter(rdr, pUid, len);
+   testRunUs(50000);
+   int idx = testFindMsg(from, msg, sizeof(msg));
+   CHECK(idx >= 0);
+   CHECK(hostCnt.irqs > irqs);
+   if (idx >= 0) {
+      CHECK(hostLnLog[idx].startUs - t0 < 2 * IRQ_REARM_PERIOD * 1000UL);
+      CHECK(testFindMsg(idx + 1, msg, sizeof(msg)) < 0); //halted tag: reported once
+   }
+   return idx;
+}
+
+static uint8_t irqPin;
+static uint32_t irqNr;
+static uint64_t irqFirstUs;
+
+static void irqHook(uint8_t pin){
+   if (pin == irqPin) {
+      if (irqNr == 0) {
+         irqFirstUs = hostUs();
+      }
+      irqNr++;
+   }
+}
+
+/*
+ * The time stamp of the tag message is the tag answer to the REQA (the first IRQ after the
+ * rearm), not an IRQ of the UID reading. The bus is kept busy, so the message waits in the ring
+ */
+static void tagTimeStamp(uint8_t rdr, const uint8_t *pUid, uint8_t len){
+   const uint8_t irqPins[] = RFID_IRQ_PINS;
+   uint32_t ulTagTime = 0;
+   uint64_t t0 = hostUs();
+
+   irqPin = irqPins[rdr];
+   irqNr = 0;
+   hostIrqHook = irqHook;
+   testBusBusy(100000);
+   hostTagEnter(rdr, pUid, len);
+   while ((ulTagTime == 0) && (hostUs() < t0 + 50000)) {
+      testRunUs(HOST_LOOP_US);
+      if (lnRingCount() > 0) {
+         ulTagTime = lnTxRing.tagTime[lnTxRing.tail & LN_BUFF_MASK];
+      }
+   }
+   hostIrqHook = NULL;
+   CHECK(irqNr > 1); //the REQA answer and the UID reading
+   CHECK((ulTagTime != 0) && (ulTagTime - (uint32_t)irqFirstUs < 20));
+   testRunUs(200000);
+}
+
+/* the tag leaves: the port is reported free after the hold-off and the debounce time*/
+static void tagLeaves(uint8_t rdr, const uint8_t *pUid, uint8_t len){
+   uint8_t msg[3];
+   uint32_t from = hostLnLogNr;
+
+   testSensorMsg(rdr, false, msg);
+   hostTagLeave(rdr, pUid, len);
+   testRunUs(PRES_HOLDOFF_DEF * 10000UL + PRES_DEBOUNCE_DEF * 1000UL + 100000);
+   CHECK(testFindMsg(from, msg, sizeof(msg)) >= 0);
+}
+
+int main(void){
+   testBoot(2);
+   CHECK(rfidPorts[0].bActive);
+   CHECK(rfidPorts[1].bActive);
+
+   /* idle: no tag, no interrupt; the readers are only rearmed (up to 8 frames each)*/
+   __hostCntType cnt0 = hostCnt;
+   uint32_t spiFrames = hostCnt.spiFrames;
+   testRunUs(100000);
+   CHECK(hostCnt.irqs == cnt0.irqs);
+   CHECK(hostCnt.spiFrames - spiFrames <= (100 / IRQ_REARM_PERIOD + 1) * 2 * 8);
+
+   tagReported(0, uidA, sizeof(uidA));
+   tagReported(1, uidB, sizeof(uidB));
+   tagLeaves(0, uidA, sizeof(uidA));
+   tagLeaves(1, uidB, sizeof(uidB));
+
+   /* the port free again: the next tag is detected by its interrupt*/
+   testRunUs(PRES_DEBOUNCE_DEF * 1000UL);
+   tagReported(0, uidC, sizeof(uidC));
+   tagLeaves(0, uidC, sizeof(uidC));
+
+   testRunUs(PRES_DEBOUNCE_DEF * 1000UL);
+   tagTimeStamp(1, uidA, sizeof(uidA));
+   tagLeaves(1, uidA, sizeof(uidA));
+   return testResult("test_irq");
+}
@@ -0,0 +1,66 @@
+/*
+ * MULTI_TAG_MODE: all the tags in the field are reported, each once, 10 byte UIDs included;
+ * the messages of a port keep their order while they wait for the bus
+ */
+#include "hosttest.h"
+
+#if !MULTI_TAG_MODE
+  #error "test_multi is built with MULTI_TAG_MODE=1"
+#endif
+
+static const uint8_t uidA[10] = {0x04, 0x81, 0x92, 0xA3, 0xB4, 0xC5, 0xD6, 0xE7, 0xF8, 0x09};
+static const uint8_t uidB[10] = {0x04, 0x81, 0x92, 0xA3, 0xB4, 0xC5, 0xD7, 0x11, 0x22, 0x33};
+static const uint8_t uidC[7] = {0x04, 0x17, 0xE8, 0x39, 0x4A, 0x5B, 0xEC};
+static const uint8_t uidD[4] = {0xDE, 0xAD, 0x7E, 0x01};
+
+static uint8_t msgA[LN_UID_HDR_LEN + UID_LEN + 1];
+static uint8_t msgB[LN_UID_HDR_LEN + UID_LEN + 1];
+static uint8_t msgC[LN_UID_HDR_LEN + UID_LEN + 1];
+static uint8_t msgFree[3];
+
+int main(void){
+   testBoot(2);
+   testUidMsg(0, uidA, sizeof(uidA), msgA);
+   testUidMsg(0, uidB, sizeof(uidB), msgB);
+   testUidMsg(0, uidC, sizeof(uidC), msgC);
+   testSensorMsg(0, false, msgFree);
+
+   /* two 10 byte UID tags with the same first 6 bytes: both reported, once*/
+   uint32_t from = hostLnLogNr;
+   hostTagEnter(0, uidA, sizeof(uidA));
+   hostTagEnter(0, uidB, sizeof(uidB));
+   testRunUs(500000);
+   CHECK(testCountMsg(from, msgA, sizeof(msgA)) == 1);
+   CHECK(testCountMsg(from, msgB, sizeof(msgB)) == 1);
+   hostTagLeave(0, uidA, sizeof(uidA));
+   hostTagLeave(0, uidB, sizeof(uidB));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000);
+   CHECK(rfidPorts[0].presState == PRES_FREE);
+
+   /* bus busy: free, tags, free wait in the ring and are sent in this order*/
+   hostTagEnter(0, uidC, sizeof(uidC));
+   testRunUs(100000);
+   testBusBusy(2000000);
+   from = hostLnLogNr;
+   hostTagEnter(1, uidD, sizeof(uidD));           //a message of reader 1 first in the ring
+   testRunUs(100000);
+   hostTagLeave(0, uidC, sizeof(uidC));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000); //free of C queued
+   hostTagEnter(0, uidA, sizeof(uidA));
+   hostTagEnter(0, uidB, sizeof(uidB));
+   testRunUs(100000);                             //A and B queued
+   hostTagLeave(0, uidA, sizeof(uidA));
+   hostTagLeave(0, uidB, sizeof(uidB));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000); //free of A and B queued
+   CHECK(hostLnLogNr == from);                    //nothing sent yet
+   testRunUs(2000000);
+
+   int idxFree1 = testFindMsg(from, msgFree, sizeof(msgFree));
+   int idxA = testFindMsg(from, msgA, sizeof(msgA));
+   int idxB = testFindMsg(from, msgB, sizeof(msgB));
+   int idxFree2 = (idxFree1 >= 0) ? testFindMsg(idxFree1 + 1, msgFree, sizeof(msgFree)) : -1;
+   CHECK((idxFree1 >= 0) && (idxA > idxFree1) && (idxB > idxFree1));
+   CHECK((idxFree2 > idxA) && (idxFree2 > idxB));
+
+   return testResult("test_multi");
+}
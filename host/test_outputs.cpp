@@ -0,0 +1,112 @@
+/*
+ * Output ports: a reconfiguration keeps the state of the outputs whose pin and switch
+ * address are unchanged; a changed output starts LOW. OPC_SW_STATE is answered with an
+ * OPC_LONG_ACK holding the state of the switch
+ */
+#include "hosttest.h"
+
+static const uint8_t outPinsTab[] = OUT_PINS;
+
+#define PORT_A   NR_OF_RFID_PORTS
+#define PORT_B   (NR_OF_RFID_PORTS + 1)
+
+/* port as an output of the switch address, turned on by the "closed" direction*/
+static void outputSet(uint8_t port, uint16_t uiAddr){
+   uint16_t offset = SV_ADDR_USER_BASE + 3 + 3 * port;
+
+   svWrite(offset, OUT_PORT_TYPE);
+   svWrite(offset + 1, (uiAddr - 1) & 0x7F);
+   svWrite(offset + 2, (((uiAddr - 1) >> 7) & 0x0F) | 0x20);
+}
+
+/* OPC_SW_REQ "on" of the switch address, closed*/
+static void injectSwReq(uint16_t uiAddr){
+   uint8_t msg[4];
+
+   msg[0] = OPC_SW_REQ;
+   msg[1] = (uiAddr - 1) & 0x7F;
+   msg[2] = (((uiAddr - 1) >> 7) & 0x0F) | 0x30;
+   msg[3] = 0xFF ^ msg[0] ^ msg[1] ^ msg[2];
+   hostLnInject(hostUs() + 1000, msg);
+}
+
+/* OPC_SW_STATE of the switch address*/
+static void injectSwState(uint16_t uiAddr){
+   uint8_t msg[4];
+
+   msg[0] = OPC_SW_STATE;
+   msg[1] = (uiAddr - 1) & 0x7F;
+   msg[2] = ((uiAddr - 1) >> 7) & 0x0F;
+   msg[3] = 0xFF ^ msg[0] ^ msg[1] ^ msg[2];
+   hostLnInject(hostUs() + 1000, msg);
+}
+
+/* the number of OPC_SW_STATE replies sent from the log entry 'from', the last one in *pAck1*/
+static uint32_t swStateReplies(uint32_t from, uint8_t *pAck1){
+   const uint8_t lack[] = {OPC_LONG_ACK, OPC_SW_STATE & 0x7F};
+   uint32_t n = 0;
+
+   for (int idx = testFindMsg(from, lack, sizeof(lack)); idx >= 0; idx = testFindMsg(idx + 1, lack, sizeof(lack))) {
+      *pAck1 = hostLnLog[idx].msg.data[2];
+      n++;
+   }
+   return n;
+}
+
+int main(void){
+   uint8_t ucAck1 = 0;
+
+   uint8_t pinA = outPinsTab[PORT_A - NR_OF_RFID_PORTS];
+   uint8_t pinB = outPinsTab[PORT_B - NR_OF_RFID_PORTS];
+
+   testBoot(1);
+   outputSet(PORT_A, 100);
+   outputSet(PORT_B, 200);
+   boardReconfigure();
+   injectSwReq(100);
+   injectSwReq(200);
+   testRunUs(50000);
+   CHECK((hostPinLevel(pinA) == HIGH) && (hostPinLevel(pinB) == HIGH));
+
+   /* A on by "closed": reported closed; no reply for an address without output*/
+   uint32_t from = hostLnLogNr;
+   injectSwState(100);
+   testRunUs(20000);
+   CHECK((swStateReplies(from, &ucAck1) == 1) && (ucAck1 == OUT_ACK_CLOSED));
+   from = hostLnLogNr;
+   injectSwState(300);
+   testRunUs(20000);
+   CHECK(swStateReplies(from, &ucAck1) == 0);
+
+   /* a reconfiguration with nothing changed*/
+   boardReconfigure();
+   testRunUs(10000);
+   CHECK((hostPinLevel(pinA) == HIGH) && (hostPinLevel(pinB) == HIGH));
+
+   /* B gets another address: only B starts again from LOW*/
+   outputSet(PORT_B, 201);
+   boardReconfigure();
+   testRunUs(10000);
+   CHECK((hostPinLevel(pinA) == HIGH) && (hostPinLevel(pinB) == LOW));
+   from = hostLnLogNr;
+   injectSwState(201);
+   testRunUs(20000);
+   CHECK((swStateReplies(from, &ucAck1) == 1) && (ucAck1 == OUT_ACK_THROWN));
+
+   /* the old address of B doesn't drive it anymore, the new one does*/
+   injectSwReq(200);
+   testRunUs(10000);
+   CHECK(hostPinLevel(pinB) == LOW);
+   injectSwReq(201);
+   testRunUs(10000);
+   CHECK((hostPinLevel(pinA) == HIGH) && (hostPinLevel(pinB) == HIGH));
+
+   /* A no longer an output: its pin is released, B is kept*/
+   svWrite(SV_ADDR_USER_BASE + 3 + 3 * PORT_A, 0);
+   boardReconfigure();
+   testRunUs(10000);
+   CHECK(hostPinLevel(pinB) == HIGH);
+   CHECK((outsNr == 1) && (outputs[0].idx == PORT_B) && (outputs[0].state == HIGH));
+
+   return testResult("test_outputs");
+}
@@ -0,0 +1,93 @@
+/*
+ * Tag presence: the free report is held for the debounce time after the hold-off; a tag back
+ * within it keeps the port occupied without any message, later it is reported again. A tag
+ * replacing another one without a gap is reported with no free report in between. A tag
+ * with a 10 byte UID is recognised by its first 7 bytes
+ */
+#include "hosttest.h"
+
+static const uint8_t uidA[7] = {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66};
+static const uint8_t uidB[7] = {0x04, 0x17, 0xE8, 0x39, 0x4A, 0x5B, 0xEC};
+static const uint8_t uidL[10] = {0x04, 0x81, 0x92, 0xA3, 0xB4, 0xC5, 0xD6, 0xE7, 0xF8, 0x09};
+
+static uint8_t msgA[LN_UID_HDR_LEN + UID_LEN + 1];
+static uint8_t msgB[LN_UID_HDR_LEN + UID_LEN + 1];
+static uint8_t msgL[LN_UID_HDR_LEN + UID_LEN + 1];
+static uint8_t msgFree[3];
+
+int main(void){
+   testBoot(1);
+   testUidMsg(0, uidA, sizeof(uidA), msgA);
+   testUidMsg(0, uidB, sizeof(uidB), msgB);
+   testUidMsg(0, uidL, sizeof(uidL), msgL);
+   testSensorMsg(0, false, msgFree);
+
+   /* A arrives, leaves and comes back within the debounce time: one report, no free*/
+   uint32_t from = hostLnLogNr;
+   hostTagEnter(0, uidA, sizeof(uidA));
+   testRunUs(100000);
+   hostTagLeave(0, uidA, sizeof(uidA));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US / 2);
+   CHECK(rfidPorts[0].presState == PRES_HELD);
+   hostTagEnter(0, uidA, sizeof(uidA));
+   testRunUs(100000);
+   CHECK(rfidPorts[0].presState == PRES_PRESENT);
+   CHECK(testCountMsg(from, msgA, sizeof(msgA)) == 1);
+   CHECK(testCountMsg(from, msgFree, sizeof(msgFree)) == 0);
+
+   /* A leaves: reported free once after the hold-off and the debounce time*/
+   hostTagLeave(0, uidA, sizeof(uidA));
+   from = hostLnLogNr;
+   testRunUs(HOLDOFF_US + DEBOUNCE_US / 2);
+   CHECK(testCountMsg(from, msgFree, sizeof(msgFree)) == 0);
+   testRunUs(DEBOUNCE_US);
+   CHECK(rfidPorts[0].presState == PRES_FREE);
+   CHECK(testCountMsg(from, msgFree, sizeof(msgFree)) == 1);
+
+   /* A back after the free report: reported again*/
+   from = hostLnLogNr;
+   hostTagEnter(0, uidA, sizeof(uidA));
+   testRunUs(100000);
+   CHECK(testCountMsg(from, msgA, sizeof(msgA)) == 1);
+
+   /* B replaces A within the debounce time: A's free report first, then B*/
+   hostTagLeave(0, uidA, sizeof(uidA));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US / 2);
+   from = hostLnLogNr;
+   hostTagEnter(0, uidB, sizeof(uidB));
+   testRunUs(100000);
+   int idxFree = testFindMsg(from, msgFree, sizeof(msgFree));
+   int idxB = testFindMsg(from, msgB, sizeof(msgB));
+   CHECK((idxFree >= 0) && (idxB > idxFree));
+   hostTagLeave(0, uidB, sizeof(uidB));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000);
+
+   /* B replaces A while the port is occupied, no gap: A and B reported once each, no free*/
+   from = hostLnLogNr;
+   hostTagEnter(0, uidA, sizeof(uidA));
+   testRunUs(100000);
+   CHECK(rfidPorts[0].presState == PRES_PRESENT);
+   hostTagLeave(0, uidA, sizeof(uidA));
+   hostTagEnter(0, uidB, sizeof(uidB));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000);
+   CHECK(testCountMsg(from, msgA, sizeof(msgA)) == 1);
+   CHECK(testCountMsg(from, msgB, sizeof(msgB)) == 1);
+   CHECK(testCountMsg(from, msgFree, sizeof(msgFree)) == 0);
+   CHECK(rfidPorts[0].presState == PRES_PRESENT);
+   hostTagLeave(0, uidB, sizeof(uidB));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000);
+
+   /* 10 byte UID: the first 7 bytes reported, once*/
+   from = hostLnLogNr;
+   hostTagEnter(0, uidL, sizeof(uidL));
+   testRunUs(500000);
+   hostTagLeave(0, uidL, sizeof(uidL));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US / 2);
+   hostTagEnter(0, uidL, sizeof(uidL)); //back within the debounce time: the same tag
+   testRunUs(100000);
+   CHECK(testCountMsg(from, msgL, sizeof(msgL)) == 1);
+   CHECK(testCountMsg(from, msgFree, sizeof(msgFree)) == 0);
+   CHECK(rfidPorts[0].presState == PRES_PRESENT);
+
+   return testResult("test_presence");
+}
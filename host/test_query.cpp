@@ -0,0 +1,67 @@
+/*
+ * Sensor query (OPC_SW_REQ to 1017): the state of each active reader is reported, and the
+ * messages of a port keep their order when they wait for the bus: a tag arriving after the
+ * query is the last state of its port on the bus
+ */
+#include "hosttest.h"
+
+static const uint8_t uidA[7] = {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66};
+static const uint8_t uidB[7] = {0x04, 0x17, 0xE8, 0x39, 0x4A, 0x5B, 0xEC};
+static const uint8_t uidD[4] = {0xDE, 0xAD, 0x7E, 0x01};
+
+#define QUERY_US     (SEN_QUERY_SLOTS * SEN_QUERY_SLOT_MS * 1000UL)
+
+static const uint8_t query[] = {OPC_SW_REQ, SEN_QUERY_LOW_ADDRESS, 0x20 | SEN_QUERY_HIGH_ADDRESS,
+                                0xFF ^ OPC_SW_REQ ^ SEN_QUERY_LOW_ADDRESS ^ (0x20 | SEN_QUERY_HIGH_ADDRESS)};
+
+int main(void){
+   uint8_t msgB[LN_UID_HDR_LEN + UID_LEN + 1];
+   uint8_t msgD[LN_UID_HDR_LEN + UID_LEN + 1];
+   uint8_t free0[3];
+   uint8_t occ0[3];
+   uint8_t occ1[3];
+
+   testBoot(2);
+   testUidMsg(0, uidB, sizeof(uidB), msgB);
+   testUidMsg(1, uidD, sizeof(uidD), msgD);
+   testSensorMsg(0, false, free0);
+   testSensorMsg(0, true, occ0);
+   testSensorMsg(1, true, occ1);
+
+   /* idle bus: the query is answered with the state of both readers*/
+   hostTagEnter(1, uidD, sizeof(uidD));
+   testRunUs(100000);
+   uint32_t from = hostLnLogNr;
+   hostLnInject(hostUs() + 1000, query);
+   testRunUs(QUERY_US + 200000);
+   CHECK(testFindMsg(from, free0, sizeof(free0)) >= 0);
+   int idxOcc1 = testFindMsg(from, occ1, sizeof(occ1));
+   CHECK((idxOcc1 >= 0) && (testFindMsg(idxOcc1 + 1, msgD, sizeof(msgD)) == idxOcc1 + 1));
+
+   /* busy bus: A's free report, the query answer and B's tag wait in the ring*/
+   hostTagEnter(0, uidA, sizeof(uidA));
+   testRunUs(100000);
+   testBusBusy(3000000);
+   from = hostLnLogNr;
+   hostTagLeave(1, uidD, sizeof(uidD));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000);  //free of reader 1 first in the ring
+   hostTagLeave(0, uidA, sizeof(uidA));
+   testRunUs(HOLDOFF_US + DEBOUNCE_US + 100000);  //free of A queued
+   hostLnInject(hostUs() + 1000, query);
+   testRunUs(QUERY_US + 100000);                  //query answer queued
+   hostTagEnter(0, uidB, sizeof(uidB));
+   testRunUs(100000);                             //B queued
+   CHECK(hostLnLogNr == from);
+   testRunUs(3000000);
+
+   /* the last message of reader 0 is B, after all its free reports*/
+   int idxB = testFindMsg(from, msgB, sizeof(msgB));
+   int idxFree = -1;
+   for (int idx = testFindMsg(from, free0, sizeof(free0)); idx >= 0; idx = testFindMsg(idx + 1, free0, sizeof(free0))) {
+      idxFree = idx;
+   }
+   CHECK((idxB >= 0) && (idxFree >= 0) && (idxB > idxFree));
+   CHECK(testFindMsg(from, occ0, sizeof(occ0)) < 0);
+
+   return testResult("test_query");
+}
@@ -0,0 +1,68 @@
+/*
+ * Speed of a reader pair: two tags between the readers at once are measured each on its
+ * own; a tag seen by reader A after another one isn't reported with the time of the first
+ */
+#include "hosttest.h"
+
+static const uint8_t uidX[7] = {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66};
+static const uint8_t uidY[7] = {0x04, 0x17, 0xE8, 0x39, 0x4A, 0x5B, 0xEC};
+
+#define DIST_MM   1000
+
+/* the speed in mm/s of the first speed report of the pair from the log entry 'from'; -1 = none*/
+static int speedFind(uint32_t from, uint8_t ucDir, uint32_t *pIdx){
+   uint8_t msg[6] = {0xE4, LN_SPEED_LEN, LN_SPEED_TYPE, rfidPorts[0].addrHiSen, rfidPorts[0].addrLoSen, ucDir};
+   int idx = testFindMsg(from, msg, sizeof(msg));
+
+   if (idx < 0) {
+      return -1;
+   }
+   *pIdx = idx;
+   return (hostLnLog[idx].msg.data[6] << 7) | hostLnLog[idx].msg.data[7];
+}
+
+/* the tag passes the reader: in the field for 100 ms*/
+static void tagPass(uint8_t rdr, const uint8_t *pUid){
+   hostTagEnter(rdr, pUid, 7);
+   testRunUs(100000);
+   hostTagLeave(rdr, pUid, 7);
+}
+
+int main(void){
+   uint32_t idx;
+
+   testBoot(2);
+   svWrite(SV_ADDR_USER_BASE + SV_CFG_PAIR, 1);     //reader A = port 0
+   svWrite(SV_ADDR_USER_BASE + SV_CFG_PAIR + 1, 2); //reader B = port 1
+   svWrite(SV_ADDR_USER_BASE + SV_CFG_PAIR + 2, DIST_MM & 0xFF);
+   svWrite(SV_ADDR_USER_BASE + SV_CFG_PAIR + 3, DIST_MM >> 8);
+
+   /* X at A, Y at A 0.5 s later, X at B 1 s after A: X at 1000 mm/s*/
+   uint32_t from = hostLnLogNr;
+   tagPass(0, uidX);
+   testRunUs(400000);
+   tagPass(0, uidY);
+   testRunUs(400000);
+   tagPass(1, uidX);
+   testRunUs(100000);
+   int speed = speedFind(from, 0, &idx);
+   CHECK((speed >= 950) && (speed <= 1050));
+
+   /* Y at B 1.5 s after A: its own passage too, 1000 mm in 1.5 s*/
+   from = idx + 1;
+   testRunUs(800000);
+   tagPass(1, uidY);
+   testRunUs(100000);
+   speed = speedFind(from, 0, &idx);
+   CHECK((speed >= 630) && (speed <= 700));
+   CHECK(speedFind(idx + 1, 0, &idx) < 0);
+
+   /* both passages closed: X back at B starts a new one from B, no report*/
+   from = hostLnLogNr;
+   tagPass(1, uidX);
+   testRunUs(100000);
+   CHECK(speedFind(from, 0, &idx) < 0);
+   CHECK(speedFind(from, 1, &idx) < 0);
+
+   return testResult("test_speed");
+}
@@ -0,0 +1,140 @@
+/*
+ * LNSV2 bulk transfers: 12 SVs written and read back with SV_CMD_WRITE4 / SV_CMD_READ4 take a
+ * quarter of the round trips of SV_CMD_WRITE / SV_CMD_READ, with the same result (values with
+ * the MSB set, packed in SVX1 / SVX2). SV_CMD_CHANGE_ADDR takes only a LocoIO address
+ */
+#include "hosttest.h"
+
+#define TEST_SV_FIRST  (SV_ADDR_USER_BASE + 64) /* LocoIO SVs 64.. : not used by the board*/
+#define TEST_SV_NR     12
+#define TEST_REPLY_US  300000
+
+static uint32_t roundTrips = 0;
+
+/* pack the MSBs of the 4 bytes after pData[0] in pData[0]*/
+static void packMsbs(uint8_t *pData){
+   pData[0] = 0x10;
+   for (uint8_t i = 0; i < 4; i++) {
+      pData[0] |= ((pData[i + 1] >> 7) & 0x01) << i;
+      pData[i + 1] &= 0x7F;
+   }
+}
+
+static void unpackMsbs(uint8_t *pData){
+   for (uint8_t i = 0; i < 4; i++) {
+      pData[i + 1] |= ((pData[0] >> i) & 0x01) << 7;
+   }
+}
+
+/* one request and its reply; D1..D4 of the reply in pD. false = no reply*/
+static bool sv2Request(uint8_t ucCmd, uint16_t uiDst, uint16_t uiSvAdr, uint8_t *pD){
+   uint8_t req[LN_MESS_LEN_PEER] = {OPC_PEER_XFER, LN_MESS_LEN_PEER, 0x01, ucCmd, SV_TYPE_LNSV2, 0,
+                                    (uint8_t)(uiDst & 0xFF), (uint8_t)(uiDst >> 8),
+                                    (uint8_t)(uiSvAdr & 0xFF), (uint8_t)(uiSvAdr >> 8), 0,
+                                    pD[0], pD[1], pD[2], pD[3], 0};
+   packMsbs(&req[0x05]);
+   packMsbs(&req[0x0A]);
+   req[0x0F] = 0xFF;
+   for (uint8_t i = 0; i < LN_MESS_LEN_PEER - 1; i++) {
+      req[0x0F] ^= req[i];
+   }
+
+   uint32_t from = hostLnLogNr;
+   uint64_t end = hostUs() + TEST_REPLY_US;
+   const uint8_t reply[] = {OPC_PEER_XFER, LN_MESS_LEN_PEER, 0x01, (uint8_t)(ucCmd | 0x40)};
+   hostLnInject(hostUs() + LN_MESS_LEN_PEER * LN_BYTE_US, req);
+   roundTrips++;
+   while (hostUs() < end) {
+      testRunUs(1000);
+      int idx = testFindMsg(from, reply, sizeof(reply));
+      if (idx >= 0) {
+         uint8_t *pData = hostLnLog[idx].msg.data;
+         unpackMsbs(&pData[0x0A]);
+         memcpy(pD, &pData[0x0B], 4);
+         return true;
+      }
+   }
+   return false;
+}
+
+/* one request to the board and its reply*/
+static bool sv2RoundTrip(uint8_t ucCmd, uint16_t uiSvAdr, uint8_t *pD){
+   return sv2Request(ucCmd, ucBoardAddrLo | (ucBoardAddrHi << 8), uiSvAdr, pD);
+}
+
+/* SV_CMD_CHANGE_ADDR to the board (identified by its serial number); true = answered*/
+static bool sv2ChangeAddr(uint16_t uiDst){
+   uint8_t d[4] = {PRODUCT_ID & 0xFF, PRODUCT_ID >> 8, svRead(SV_ADDR_SERIAL_NUMBER_L), svRead(SV_ADDR_SERIAL_NUMBER_H)};
+
+   return sv2Request(SV_CMD_CHANGE_ADDR, uiDst, MANUF_ID | (BOARD_TYPE << 8), d);
+}
+
+static uint8_t testValue(uint8_t i, uint8_t pass){
+   return (uint8_t)(0x5A + 37 * i + pass) | ((i & 1) ? 0x80 : 0); //every other value with the MSB set
+}
+
+int main(void){
+   uint8_t d[4];
+
+   testBoot(2);
+
+   /* single byte path*/
+   uint64_t t0 = hostUs();
+   roundTrips = 0;
+   for (uint8_t i = 0; i < TEST_SV_NR; i++) {
+      memset(d, 0, sizeof(d));
+      d[0] = testValue(i, 0);
+      CHECK(sv2RoundTrip(SV_CMD_WRITE, TEST_SV_FIRST + i, d));
+      CHECK(d[0] == testValue(i, 0));
+   }
+   for (uint8_t i = 0; i < TEST_SV_NR; i++) {
+      memset(d, 0, sizeof(d));
+      CHECK(sv2RoundTrip(SV_CMD_READ, TEST_SV_FIRST + i, d));
+      CHECK(d[0] == testValue(i, 0));
+   }
+   uint32_t singleTrips = roundTrips;
+   uint64_t singleUs = hostUs() - t0;
+
+   /* 4 bytes path*/
+   t0 = hostUs();
+   roundTrips = 0;
+   for (uint8_t i = 0; i < TEST_SV_NR; i += 4) {
+      for (uint8_t j = 0; j < 4; j++) {
+         d[j] = testValue(i + j, 1);
+      }
+      CHECK(sv2RoundTrip(SV_CMD_WRITE4, TEST_SV_FIRST + i, d));
+   }
+   for (uint8_t i = 0; i < TEST_SV_NR; i += 4) {
+      memset(d, 0, sizeof(d));
+      CHECK(sv2RoundTrip(SV_CMD_READ4, TEST_SV_FIRST + i, d));
+      for (uint8_t j = 0; j < 4; j++) {
+         CHECK(d[j] == testValue(i + j, 1));
+      }
+   }
+   uint32_t bulkTrips = roundTrips;
+   uint64_t bulkUs = hostUs() - t0;
+
+   for (uint8_t i = 0; i < TEST_SV_NR; i++) {
+      CHECK(svRead(TEST_SV_FIRST + i) == testValue(i, 1));
+   }
+   testRunUs(1000000); //idle: the SVs are flushed to the EEPROM
+   for (uint8_t i = 0; i < TEST_SV_NR; i++) {
+      CHECK(hostEeprom[TEST_SV_FIRST + i - 2] == testValue(i, 1));
+   }
+
+   printf("%u SVs written + read: %u round trips / %llu ms single byte, %u round trips / %llu ms WRITE4 / READ4\n",
+          TEST_SV_NR, singleTrips, (unsigned long long)(singleUs / 1000), bulkTrips, (unsigned long long)(bulkUs / 1000));
+   CHECK(singleTrips == 2 * TEST_SV_NR);
+   CHECK(bulkTrips * 4 == singleTrips);
+   CHECK(bulkUs < singleUs);
+
+   /* SV_CMD_CHANGE_ADDR: only a LocoIO address (high 1, low 1..127) is taken*/
+   uint8_t ucAddrLo = ucBoardAddrLo;
+   CHECK(!sv2ChangeAddr(0x0255));
+   CHECK(!sv2ChangeAddr(0x0180));
+   CHECK(!sv2ChangeAddr(0x0100));
+   CHECK((ucBoardAddrLo == ucAddrLo) && (ucBoardAddrHi == 1));
+   CHECK(sv2ChangeAddr(0x0155));
+   CHECK((ucBoardAddrLo == 0x55) && (ucBoardAddrHi == 1));
+   return testResult("test_sv");
+}
@@ -0,0 +1,127 @@
+/*
+ * UID table: a SET received from the bus doesn't block loop() with its EEPROM writes, the
+ * table reads see the writes still queued, and the transponding absent report of a port
+ * keeps its place in the ring when the loco comes back while the bus is busy
+ */
+#include "hosttest.h"
+
+static const uint8_t uidA[7] = {0x04, 0x91, 0x22, 0xB3, 0x44, 0xD5, 0x66};
+static const uint8_t uidB[7] = {0x04, 0x17, 0xE8, 0x39, 0x4A, 0x5B, 0xEC};
+static const uint8_t uidD[4] = {0xDE, 0xAD, 0x7E, 0x01};
+
+#define LOCO_A       1234
+#define LOCO_B       3
+
+static uint32_t maxPassEeWrites = 0;
+
+/* like testRunUs(), with the most EEPROM writes done in one loop() pass*/
+static void runUs(uint64_t us){
+   uint64_t end = hostUs() + us;
+   while (hostUs() < end) {
+      hostAdvanceUs(HOST_LOOP_US);
+      uint32_t ee = hostEeWrites;
+      loop();
+      if (hostEeWrites - ee > maxPassEeWrites) {
+         maxPassEeWrites = hostEeWrites - ee;
+      }
+   }
+}
+
+/* an LNSV2 UID table command to the board: D1..D4 and SV_ADR*/
+static void injectUidTabCmd(uint8_t ucCmd, uint16_t uiSvAdr, const uint8_t *pD){
+   uint8_t msg[LN_MESS_LEN_PEER];
+   uint16_t uiDst = ucBoardAddrLo | (ucBoardAddrHi << 8);
+   uint8_t d[8] = {(uint8_t)(uiDst & 0xFF), (uint8_t)(uiDst >> 8), (uint8_t)(uiSvAdr & 0xFF), (uint8_t)(uiSvAdr >> 8),
+                   pD[0], pD[1], pD[2], pD[3]};
+
+   msg[0] = OPC_PEER_XFER;
+   msg[1] = LN_MESS_LEN_PEER;
+   msg[2] = 0x01;
+   msg[3] = ucCmd;
+   msg[4] = 0x02;
+   msg[5] = 0x10;
+   msg[10] = 0x10;
+   for (uint8_t i = 0; i < 8; i++) {
+      uint8_t idx = (i < 4) ? 6 + i : 7 + i;
+      msg[idx] = d[i] & 0x7F;
+      msg[(i < 4) ? 5 : 10] |= (d[i] >> 7) << (i & 0x03);
+   }
+   msg[15] = 0xFF;
+   for (uint8_t i = 0; i < 15; i++) {
+      msg[15] ^= msg[i];
+   }
+   hostLnInject(hostUs() + 1000, msg);
+}
+
+/* the OPC_MULTI_SENSE transponding message of the port, without the check summ*/
+static void transpMsg(uint8_t port, uint16_t uiLoco, bool bPresent, uint8_t *pMsg){
+   uint16_t uiZone = rfidPorts[port].addrSenFull - 1;
+
+   pMsg[0] = OPC_MULTI_SENSE;
+   pMsg[1] = ((uiZone >> 7) & 0x1F) | (bPresent ? 0x20 : 0x00);
+   pMsg[2] = uiZone & 0x7F;
+   pMsg[3] = (uiLoco < 128) ? 0x7D : (uiLoco >> 7) & 0x7F;
+   pMsg[4] = (uiLoco < 128) ? uiLoco : uiLoco & 0x7F;
+}
+
+int main(void){
+   uint8_t present0[5];
+   uint8_t absent0[5];
+   uint8_t free0[3];
+   uint8_t uid[UID_LEN];
+
+   testBoot(2);
+   transpMsg(0, LOCO_A, true, present0);
+   transpMsg(0, LOCO_A, false, absent0);
+   testSensorMsg(0, false, free0);
+
+   /* SET from the bus: replied at once, the EEPROM is written later, one byte per pass*/
+   uint32_t ee0 = hostEeWrites;
+   uint32_t from = hostLnLogNr;
+   injectUidTabCmd(SV_CMD_UIDTAB_STAGE, 0, uidA);
+   runUs(20000);
+   const uint8_t setA[4] = {uidA[4], uidA[5], uidA[6], 0};
+   injectUidTabCmd(SV_CMD_UIDTAB_SET, LOCO_A, setA);
+   runUs(200000);
+   CHECK(hostLnLogNr == from + 2);
+   CHECK((hostLnLog[from + 1].msg.data[3] == (SV_CMD_UIDTAB_SET | 0x40)) && (hostLnLog[from + 1].msg.data[11] == 1));
+   CHECK(hostEeWrites - ee0 >= UIDTAB_ENTRY_LEN);
+   CHECK(maxPassEeWrites == 1);
+
+   /* the table as read back includes the writes still queued*/
+   memset(uid, 0, sizeof(uid));
+   memcpy(uid, uidB, sizeof(uidB));
+   ee0 = hostEeWrites;
+   CHECK(uidTabSet(uid, LOCO_B) && (hostEeWrites == ee0));
+   CHECK((uidTabLookup(uid) == LOCO_B) && (uidTabCnt == 2));
+   CHECK(uidTabDelete(uid) && (uidTabLookup(uid) == 0) && (uidTabCnt == 1));
+   memcpy(uid, uidA, sizeof(uidA));
+   CHECK(uidTabLookup(uid) == LOCO_A);
+   runUs(200000);
+   CHECK(EEPROM.read(UIDTAB_EE_BASE) == 1);
+
+   /* busy bus: the loco A leaves (free + absent queued) and comes back (present queued)*/
+   hostTagEnter(0, uidA, sizeof(uidA));
+   hostTagEnter(1, uidD, sizeof(uidD));
+   runUs(100000);
+   CHECK(testFindMsg(from, present0, sizeof(present0)) >= 0);
+   testBusBusy(3000000);
+   from = hostLnLogNr;
+   hostTagLeave(1, uidD, sizeof(uidD));
+   runUs(HOLDOFF_US + DEBOUNCE_US + 100000);  //free of reader 1 first in the ring
+   hostTagLeave(0, uidA, sizeof(uidA));
+   runUs(HOLDOFF_US + DEBOUNCE_US + 100000);  //free + absent of reader 0 queued
+   hostTagEnter(0, uidA, sizeof(uidA));
+   runUs(100000);                             //present queued
+   CHECK(hostLnLogNr == from);
+   runUs(3000000);
+
+   /* on the bus: free, absent, then present as the last state of reader 0*/
+   int idxFree = testFindMsg(from, free0, sizeof(free0));
+   int idxAbsent = testFindMsg(from, absent0, sizeof(absent0));
+   int idxPresent = testFindMsg(from, present0, sizeof(present0));
+   CHECK((idxFree >= 0) && (idxAbsent > idxFree) && (idxPresent > idxAbsent));
+   CHECK(testFindMsg(idxPresent + 1, absent0, sizeof(absent0)) < 0);
+
+   return testResult("test_uidtab");
+}
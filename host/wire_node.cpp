@@ -0,0 +1,49 @@
+/*
+ * LocoNet bus of a node of the lnsim bus simulator, see lnsim.h. The attempts and the
+ * receive calls go to the wire of lnsim.cpp; the clock of the node moves on to the end of
+ * each attempt, as the library busy-waits the transmission
+ */
+#include <SPI.h>
+#include <MFRC522.h>
+#include <LocoNet.h>
+#include "lnsim.h"
+#include "../rfid2ln.h"
+
+extern void setup(void);
+extern void loop(void);
+
+static const __lnBusType *pLnBus = NULL;
+static uint8_t ucLnNode;
+static lnMsg lnRxMsg;
+
+static const __lnNodeType lnNode = {
+   setup, loop, &hostNs, hostAdvanceNs, hostSeed, hostReaderAdd, hostReaderPlug, hostTagSchedule,
+   svRead, svWrite, boardReconfigure
+};
+
+extern "C" const __lnNodeType *lnNodeAttach(const __lnBusType *pBus, uint8_t node){
+   pLnBus = pBus;
+   ucLnNode = node;
+   return &lnNode;
+}
+
+LN_STATUS hostLnSendTry(lnMsg *pMsg, uint8_t ucPrioDelay){
+   uint64_t endNs;
+
+   hostAdvanceNs(HOST_LN_TRY_NS);
+   LN_STATUS lnStatus = pLnBus->sendTry(ucLnNode, pMsg, ucPrioDelay, hostNs, &endNs);
+   if (endNs > hostNs) {
+      hostAdvanceNs(endNs - hostNs);
+   }
+   return lnStatus;
+}
+
+lnMsg *hostLnReceive(void){
+   hostAdvanceNs(HOST_LN_RX_NS);
+   const lnMsg *pMsg = pLnBus->receive(ucLnNode, hostNs);
+   if (pMsg == NULL) {
+      return NULL;
+   }
+   lnRxMsg = *pMsg;
+   return &lnRxMsg;
+}
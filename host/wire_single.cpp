@@ -0,0 +1,104 @@
+/*
+ * LocoNet bus of one board alone, see wire_single.h
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <LocoNet.h>
+#include <utility/ln_sw_uart.h>
+#include "wire_single.h"
+
+__lnLogType *hostLnLog = NULL;
+uint32_t hostLnLogNr = 0;
+static uint32_t lnLogCap = 0;
+
+typedef struct {
+   uint64_t endNs;
+   lnMsg    msg;
+} __lnRxType;
+
+static __lnRxType *lnRx = NULL;
+static uint32_t lnRxNr = 0;
+static uint32_t lnRxCap = 0;
+static uint32_t lnRxNext = 0;
+static uint64_t lnTxEndNs = 0;   //end of the own last message
+static lnMsg lnRxMsg;
+
+void hostLnInject(uint64_t us, const uint8_t *pData){
+   if (lnRxNr == lnRxCap) {
+      lnRxCap = lnRxCap ? 2 * lnRxCap : 64;
+      lnRx = (__lnRxType *)realloc(lnRx, lnRxCap * sizeof(__lnRxType));
+   }
+   uint32_t i = lnRxNr++;
+   while ((i > lnRxNext) && (lnRx[i - 1].endNs > us * 1000)) {
+      lnRx[i] = lnRx[i - 1];
+      i--;
+   }
+   memset(&lnRx[i].msg, 0, sizeof(lnMsg));
+   memcpy(lnRx[i].msg.data, pData, getLnMsgSize((lnMsg *)pData));
+   lnRx[i].endNs = us * 1000;
+}
+
+void hostLnClear(void){
+   hostLnLogNr = 0;
+   lnRxNr = 0;
+   lnRxNext = 0;
+}
+
+/* end of the last traffic before now; true if a message is on the bus now*/
+static bool lnBusy(uint64_t *pLastNs){
+   uint64_t last = lnTxEndNs;
+
+   for (uint32_t i = lnRxNext > 0 ? lnRxNext - 1 : 0; i < lnRxNr; i++) {
+      uint64_t lenNs = (uint64_t)getLnMsgSize(&lnRx[i].msg) * LN_BYTE_US * 1000;
+      if (lnRx[i].endNs > hostNs + lenNs) { //not started yet
+         break;
+      }
+      if (lnRx[i].endNs > hostNs) {
+         return true;
+      }
+      if (lnRx[i].endNs > last) {
+         last = lnRx[i].endNs;
+      }
+   }
+   *pLastNs = last;
+   return false;
+}
+
+LN_STATUS hostLnSendTry(lnMsg *pMsg, uint8_t ucPrioDelay){
+   uint64_t lastNs;
+
+   hostAdvanceNs(HOST_LN_TRY_NS);
+   if (lnBusy(&lastNs)) {
+      return LN_NETWORK_BUSY;
+   }
+   uint64_t bits = (hostNs - lastNs) / (LN_BIT_US * 1000);
+   if (bits < LN_CARRIER_TICKS) {
+      return LN_CD_BACKOFF;
+   }
+   if (bits < ucPrioDelay) {
+      return LN_PRIO_BACKOFF;
+   }
+
+   if (hostLnLogNr == lnLogCap) {
+      lnLogCap = lnLogCap ? 2 * lnLogCap : 256;
+      hostLnLog = (__lnLogType *)realloc(hostLnLog, lnLogCap * sizeof(__lnLogType));
+   }
+   __lnLogType *pLog = &hostLnLog[hostLnLogNr++];
+   uint8_t len = getLnMsgSize(pMsg);
+   memset(&pLog->msg, 0, sizeof(lnMsg));
+   memcpy(pLog->msg.data, pMsg->data, len);
+   pLog->startUs = hostUs();
+   hostAdvanceUs((uint64_t)len * LN_BYTE_US); //the library busy-waits the transmission
+   pLog->endUs = hostUs();
+   lnTxEndNs = hostNs;
+   return LN_DONE;
+}
+
+lnMsg *hostLnReceive(void){
+   hostAdvanceNs(HOST_LN_RX_NS);
+   if ((lnRxNext < lnRxNr) && (lnRx[lnRxNext].endNs <= hostNs)) {
+      lnRxMsg = lnRx[lnRxNext++].msg;
+      return &lnRxMsg;
+   }
+   return NULL;
+}
@@ -0,0 +1,26 @@
+/*
+ * LocoNet bus of one board alone: the attempts of the board see its own traffic and the
+ * messages injected by the host program, with the carrier detect and priority backoff of
+ * the library. The sent messages are logged with their start and end time.
+ */
+#ifndef WIRE_SINGLE_H_
+#define WIRE_SINGLE_H_
+
+#include "hostsim.h"
+
+typedef struct {
+   uint64_t startUs;
+   uint64_t endUs;
+   lnMsg    msg;
+} __lnLogType;
+
+extern __lnLogType *hostLnLog;
+extern uint32_t hostLnLogNr;
+
+/* a message of another board on the bus, received completely at the time us*/
+extern void hostLnInject(uint64_t us, const uint8_t *pData);
+
+/* clears the log and the injected messages*/
+extern void hostLnClear(void);
+
+#endif //WIRE_SINGLE_H_
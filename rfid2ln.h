@@ -31,15 +31,25 @@
 #define RFID2LN_H_
 
 #include <LocoNet.h>
+#include <utility/ln_sw_uart.h> /* sendLocoNetPacketTry(), LN_BACKOFF_xxx*/
 
 //#define UNO_LM /*my special UNO connections, to can use the same adaptor as for leonardo*/
 
+#ifndef USE_INTERRUPTS
+  #define USE_INTERRUPTS     0   /* use interrupts or polling to detect new cards; needed before the pins definition*/
+#endif
+
 #if ARDUINO >= 10500 //the board naming scheme is supported from Arduino 1.5.0
  #if (defined(ARDUINO_AVR_UNO) && !defined(UNO_LM)) || defined(ARDUINO_AVR_NANO)
   #define LN_TX_PIN       6           /* Arduino Pin used as Loconet Tx; Rx Pin is always the ICP Pin */
   #define RST_PIN         9           /* Configurable, see typical pin layout above*/
   #define SS_1_PIN       10           /* Configurable, see typical pin layout above*/   
   #define SS_2_PIN        7           /* Configurable, see typical pin layout above*/   
+  #if USE_INTERRUPTS
+    #define IRQ_1_PIN     2           /* Configurable, see typical pin layout above*/  
+    #define IRQ_2_PIN     3           /* Configurable, see typical pin layout above*/  
+  #endif
+  #define OUT_PINS       {4, 5, A0, A1, A2, A3}  /* pins of the output ports, in port order after the readers; configurable*/
 #elif defined(ARDUINO_AVR_LEONARDO) || defined(UNO_LM) 
   #define LN_TX_PIN       6           /* Arduino Pin used as Loconet Tx; Rx Pin is always the ICP Pin */
   #define RST_PIN         9           /* Configurable, see typical pin layout above*/
@@ -49,20 +59,74 @@
     #define IRQ_1_PIN     2           /* Configurable, see typical pin layout above*/  
     #define IRQ_2_PIN     3           /* Configurable, see typical pin layout above*/  
   #endif
+  #define OUT_PINS       {8, 10, 11, 12, A0, A1} /* pins of the output ports, in port order after the readers; configurable*/
+#elif defined(ARDUINO_AVR_MEGA2560)
+  #define LN_TX_PIN       6           /* Arduino Pin used as Loconet Tx; Rx Pin is always the ICP Pin */
+  #define RST_PIN         5           /* Configurable, see typical pin layout above*/
+  #define RFID_SS_PINS   {53, 47, 45, 43, 41, 39, 37, 35} /* one SS pin per reader; configurable*/
+  #if USE_INTERRUPTS
+    #define RFID_IRQ_PINS {2, 3, 18, 19, 20, 21} /* the external interrupts => maximal 6 readers with USE_INTERRUPTS*/
+  #endif
+  #define OUT_PINS       {22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 36} /* pins of the output ports; configurable*/
   #endif     
 #else //older arduino IDE => initialising each board as it is used. I'm using Leonardo
   #define LN_TX_PIN       6           /* Arduino Pin used as Loconet Tx; Rx Pin is always the ICP Pin */
   #define RST_PIN         9           /* Configurable, see typical pin layout above*/
   #define SS_1_PIN        5           /* Configurable, see typical pin layout above*/   
   #define SS_2_PIN        3           /* Configurable, see typical pin layout above*/   
+  #define OUT_PINS       {8, 10, 11, 12, A0, A1} /* pins of the output ports, in port order after the readers; configurable*/
 #endif 
 
-#define NR_OF_RFID_PORTS     2   /* Maximal number of RFID readers; the real number is detected at runtime*/ 
-#define TOTAL_NR_OF_PORTS    8   /* Maximal number of I/Os */
-#define USE_INTERRUPTS       0   /* use interrupts or polling to detect new cards*/
+#ifndef OUT_PINS
+  #define OUT_PINS       {0xFF}      /* 0xFF = no pin => the port can't be an output*/
+#endif
+
+#ifndef RFID_SS_PINS
+  #define RFID_SS_PINS   {SS_1_PIN, SS_2_PIN}
+#endif
+
+#if USE_INTERRUPTS && !defined(RFID_IRQ_PINS)
+  #ifndef IRQ_1_PIN
+    #error "USE_INTERRUPTS needs the IRQ pins of the readers (IRQ_x_PIN / RFID_IRQ_PINS)"
+  #endif
+  #define RFID_IRQ_PINS  {IRQ_1_PIN, IRQ_2_PIN}
+#endif
+
+#ifndef NR_OF_RFID_PORTS
+  #define NR_OF_RFID_PORTS   2   /* Maximal number of RFID readers (1..8); the real number is detected at runtime*/ 
+#endif
+#if NR_OF_RFID_PORTS > 8
+  #error "Maximal 8 RFID readers are supported"
+#elif NR_OF_RFID_PORTS > 4
+  #define TOTAL_NR_OF_PORTS 16   /* Maximal number of I/Os; the RFID readers use the first ports*/
+#else
+  #define TOTAL_NR_OF_PORTS  8   /* Maximal number of I/Os; the RFID readers use the first ports*/
+#endif
+
+#ifndef LN_BUFF_COALESCE
+  #define LN_BUFF_COALESCE   1   /* a new message of a port replaces the port message not yet sent*/
+#endif
+#ifndef UID_TABLE
+  #define UID_TABLE          1   /* known UIDs are reported as loco address (OPC_MULTI_SENSE transponding) instead of 0xE4 UID message*/
+#endif
+#ifndef PERF_MEASURE
+  #define PERF_MEASURE       0   /* measure the loop() timing and the tag to LocoNet latency; report it on Serial*/
+#endif
+#ifndef MULTI_TAG_MODE
+  #define MULTI_TAG_MODE     0   /* enumerate all the tags in the field of a reader (consist detection), not only the first one*/
+#endif
+#ifndef DBG_LOG
+  #define DBG_LOG            1   /* events logged in RAM on the hot path, printed on Serial only when the loop is idle*/
+#endif
+#ifndef FAST_BOOT
+  #define FAST_BOOT          1   /* no wait for Serial; one common reader reset, the readers absent at the last boot are probed later*/
+#endif
 
 #define MANUF_ID        13          /* DIY DCC*/
-#define BOARD_TYPE      5           /* something for sv.init*/
+#define BOARD_TYPE      5           /* something for sv.init; LNSV2 developer id*/
+#define PRODUCT_ID      1           /* LNSV2 product id*/
+#define SW_VERSION      1           /* LNSV2 SW version (SV 2)*/
+#define LEGACY_SERIAL   0x5678      /* fixed serial number written by the older versions*/
 
     // --------------------------------------------------------
     // OPC_PEER_XFER SV_CMD's
@@ -90,85 +154,501 @@
 #define SV_CMDR_CHANGE_ADDR     0x49    /* Transfers a Change Address response.*/
 #define SV_CMDR_RECONFIGURE     0x4F    /* Acknowledgement immediately prior to a device reconfiguration or reset*/
 
+    // UID -> loco address table (board specific LNSV2 commands, addressed as SV_CMD_WRITE; reply = command | 0x40)
+#define SV_CMD_UIDTAB_STAGE     0x10    /* D1..D4 = UID bytes 0..3, used by the next SET / DELETE*/
+#define SV_CMD_UIDTAB_SET       0x11    /* D1..D3 = UID bytes 4..6, SV_ADRL/H = loco address. Reply D1 = 1 if done, D4 = nr of entries*/
+#define SV_CMD_UIDTAB_DELETE    0x12    /* D1..D3 = UID bytes 4..6. Reply D1 = 1 if done, D4 = nr of entries*/
+#define SV_CMD_UIDTAB_CLEAR     0x13    /* delete all the entries. Reply D4 = nr of entries (0)*/
+#define SV_CMD_UIDTAB_READ      0x14    /* SV_ADRL = entry, D1 = part. Reply SV_ADRL/H = loco address (0 = no entry),
+                                           part 0: D1..D4 = UID bytes 0..3; part 1: D1..D3 = UID bytes 4..6, D4 = nr of entries*/
+
+#define SV_TYPE_LNSV2           0x02    /* SV_TYPE byte of the LNSV2 messages; LocoIO messages have the board address high there*/
+#define SV_MAX_READ             0xFF    /* LNSV2: the SVs above can't be read*/
+#define DISCOVER_SLOTS          32      /* LNSV2 discover: the reply is sent in a random slot, to avoid collisions...*/
+#define DISCOVER_SLOT_MS        10      /* ...with the replies of the other boards. Slot length in ms*/
+
 //Other LN definitions
 #define SEN_QUERY_LOW_ADDRESS   0x79    /* 1017 & 0x007F - 7 bits low address for the sensors query address 1017*/
 #define SEN_QUERY_HIGH_ADDRESS  0x07    /* (1017 >> 8) & 0x07 - high address bits for the sensors query address 1017*/
 #define LN_MESS_LEN_PEER 16
+#define SEN_QUERY_SLOTS         32      /* sensor query: the state report starts in a random slot (per board)...*/
+#define SEN_QUERY_SLOT_MS       10      /* ...slot length in ms*/
+#define SEN_QUERY_RING_FREE     4       /* sensor query: a reader is reported only with this room in the ring, left for the new tags*/
 
 //Version
 #define VER_LOW         0x01
 #define VER_HIGH        0X00
 
 #define UID_LEN          7
-#define LN_BUFF_LEN     10
+#define LN_UID_HDR_LEN   5   /* 0xE4 0x0E 0x41 <ADDR_H> <ADDR_L>*/
+#define LN_BUFF_LEN     16   /* power of 2; sent messages buffer*/
+#define LN_BUFF_MASK    (LN_BUFF_LEN - 1)
+#define LN_SV_BUFF_LEN  4    /* power of 2; SV replies waiting to be sent*/
+#define LN_SV_BUFF_MASK (LN_SV_BUFF_LEN - 1)
+#define LN_TX_TRIES     25   /* attempts to send a message (collision / bus busy) before it is dropped*/
+#define LN_NO_PORT      0xFF /* ring message not replaceable (not related to a reader, or lnRingAppend())*/
+
+/*
+ * Priority delay (bit times, LN_BACKOFF_MIN..LN_BACKOFF_MAX) of the first send attempt of a
+ * message; lowered by 1 after each failed attempt. The boards are spread over SV_CFG_PRIO_LVL levels
+ */
+#define LN_PRIO_LEGACY  0    /* level = board address % levels; boards with the same address % 10 contend identically*/
+#define LN_PRIO_HASH    1    /* level = hash of the serial number and the board address*/
+#define LN_PRIO_QUEUE   2    /* LN_PRIO_HASH, minus the number of messages waiting => a board with a backlog wins*/
+#define LN_PRIO_LVL_DEF 10
 
-#define MAX_EMPTY_READS  2
+#define PRES_DEBOUNCE_DEF   100   /* default tag debounce, ms*/
+#define PRES_HOLDOFF_DEF     20   /* default tag absent hold-off, 10 ms units*/
+
+#define SV_USER_LEN     96   /* LocoIO SVs (user SVs) kept in RAM: board address, ports table, configuration*/
+#define SV_MIRROR_LEN   (SV_ADDR_USER_BASE + SV_USER_LEN) /* SV offsets 0..SV_MIRROR_LEN-1 are mirrored*/
+#define SV_DIRTY_LEN    ((SV_MIRROR_LEN + 7) / 8)
+#define SV_PORTS_END    (TOTAL_NR_OF_PORTS * 3 + 3)       /* first LocoIO SV after the ports table*/
+
+/*
+ * Board configuration, LocoIO SVs after the biggest ports table (16 ports). 
+ * 0xFF (erased EEPROM) selects the default value
+ */
+#define SV_CFG_BASE      51
+#define SV_CFG_DEBOUNCE  (SV_CFG_BASE + 0) /* ms: the free report is held this long; a tag seen again within it keeps the port occupied*/
+#define SV_CFG_HOLDOFF   (SV_CFG_BASE + 1) /* 10 ms units: a tag must miss this long before the port is reported free*/
+#define SV_CFG_PRIO      (SV_CFG_BASE + 2) /* LocoNet priority policy: LN_PRIO_LEGACY / LN_PRIO_HASH / LN_PRIO_QUEUE*/
+#define SV_CFG_PRIO_LVL  (SV_CFG_BASE + 3) /* number of priority levels the boards are spread over*/
+#define SV_CFG_HEALTH    (SV_CFG_BASE + 4) /* 100 ms units between two reader health checks (one reader per check); 0 = no check*/
+#define SV_CFG_PAIR      (SV_CFG_BASE + 5) /* 4 per reader pair: reader A, reader B (1..; 0 = pair off), distance A-B in mm low, high*/
+#define SV_CFG_RDR_VER   (SV_CFG_PAIR + 4 * SPEED_PAIRS) /* one per reader: VersionReg found at the last probe; 0 = absent, 0xFF = not probed yet*/
+#define SV_CFG_END       (SV_CFG_RDR_VER + NR_OF_RFID_PORTS)
+
+#define svCfgRead(idx, def)  ((svMirror[SV_ADDR_USER_BASE + (idx)] == 0xFF) ? (def) : svMirror[SV_ADDR_USER_BASE + (idx)])
+
+/* tag presence state of a reader*/
+#define PRES_FREE       0    /* no tag*/
+#define PRES_PRESENT    1    /* the reported tag (oldUid) is in the field, halted*/
+#define PRES_HELD       2    /* no tag since the hold-off; the free report is held for the debounce time*/
+
+#define IRQ_REARM_PERIOD  10   /* ms between two REQA sent by an idle reader in interrupt mode*/
+
+#define RFID_RESET_MS       50     /* oscillator start of the readers after the common hard reset (FAST_BOOT) or a soft reset*/
+#define RFID_PROBE_MS     1000     /* an inactive reader is probed every RFID_PROBE_MS (hot plug), in turn*/
+#define SERIAL_POLL_MS    1000     /* FAST_BOOT: the Serial connection is checked every SERIAL_POLL_MS until found*/
+#define HEALTH_PERIOD_DEF   10     /* default time between two reader health checks, 100 ms units*/
+
+#define SPEED_PAIRS         ((NR_OF_RFID_PORTS + 1) / 2) /* reader pairs measuring the speed*/
+#define SPEED_TIMEOUT_US    30000000UL /* a tag seen by the second reader of a pair later than this is a new passage*/
+#define SPEED_DIST_MAX      42949      /* mm; the speed is calculated in 32 bit*/
+#define SPEED_OPEN_MAX      4          /* open passages (tags between the two readers) per pair; 12 bytes RAM each*/
+
+/*
+ * Reader health report, sent when a reader fails its health check (dropped from the round robin)
+ * and when it answers again: 0xE4 0x09 0x42 <ADDR_H> <ADDR_L> <STATE> <TIME_H> <TIME_L> <CHK_SUMM>.
+ * ADDR is the sensor address of the port; TIME (recovered only) is the time out of service,
+ * 100 ms units, 7 bits per byte
+ */
+#define LN_HEALTH_TYPE      0x42
+#define LN_HEALTH_LEN       9
+#define HEALTH_FAILED       0
+#define HEALTH_RECOVERED    1
+
+/*
+ * Speed report of a reader pair, sent after the UID message of the second reader:
+ * 0xE4 0x09 0x43 <ADDR_H> <ADDR_L> <DIR> <SPEED_H> <SPEED_L> <CHK_SUMM>.
+ * ADDR is the sensor address of reader A of the pair, DIR 0 = from A to B, 1 = from B to A,
+ * SPEED in mm/s (7 bits per byte, maximal 16383)
+ */
+#define LN_SPEED_TYPE       0x43
+#define LN_SPEED_LEN        9
+
+/* an open passage of a tag through a reader pair*/
+typedef struct {
+  uint8_t  uid[UID_LEN];    //UID seen by the first reader of the pair (zero filled)
+  uint32_t time;            //micros() of that detection
+  uint8_t  port;            //reader of that detection; LN_NO_PORT = free entry
+} __speedOpenType;
+
+/* the passages open in a reader pair, one per tag*/
+typedef struct {
+  __speedOpenType open[SPEED_OPEN_MAX];
+} __speedPairType;
+
+#define MULTI_TAG_MAX        4      /* MULTI_TAG_MODE: tags remembered per reader, and maximal tags read in one sweep*/
+#define MULTI_TAG_BUDGET_US  20000  /* MULTI_TAG_MODE: no new tag is read after this time in one sweep*/
+
+/*
+ * SPI access of the readers. The detection path (REQA / WUPA / HLTA) talks directly to the
+ * MFRC522 registers, with the register writes grouped in one bus transaction and the register
+ * reads in one chip select frame. The UID reading (anticollision / select) uses the library.
+ */
+#define RFID_SPI_CLOCK_DEF  4000000   /* Hz; the MFRC522 accepts up to 10 MHz, lower it for long reader cables*/
+#ifndef RFID_SPI_CLOCKS
+  #define RFID_SPI_CLOCKS   {RFID_SPI_CLOCK_DEF} /* clock per reader; the readers after the end of the list use RFID_SPI_CLOCK_DEF*/
+#endif
+#ifndef RFID_SPI_DEDICATED
+  #define RFID_SPI_DEDICATED 0x00     /* bit x set => reader x has no other device (with other settings) on the bus:
+                                         the bus transaction stays open between its bursts*/
+#endif
+#define RFID_BURST_MAX       8        /* maximal registers read in one frame*/
+#define RFID_REQ_TIMEOUT_US  500      /* the ATQA comes ~150 us after the REQA / WUPA*/
+#define RFID_HALT_TIMEOUT_US 1000     /* the HLTA frame needs ~400 us*/
+
+#define PERF_REPORT_PERIOD 5000   /* ms between two performance reports on Serial*/
 
 extern void dump_byte_array(byte *buffer, byte bufferSize);
 extern bool compareUid(byte *buffer1, byte *buffer2, byte bufferSize);
 extern void copyUid(byte *buffIn, byte *buffOut, byte bufferSize);
-extern void setMessageHeader(uint8_t port, uint8_t index);
+extern void setMessageHeader(uint8_t port);
 extern uint8_t processXferMess(lnMsg *LnRecMsg, lnMsg *LnSendMsg);
+extern boolean isSv2Message(lnMsg *LnRecMsg);
+extern uint8_t processSv2Mess(lnMsg *LnRecMsg, lnMsg *cOutBuf);
+extern void sv2DeferredProcessing(void);
+extern boolean isSenQuery(lnMsg *LnRecMsg);
+extern void senQueryProcess(void);
+extern void boardReconfigure(void);
+extern uint16_t genSerialNumber(void);
 extern uint8_t lnCalcCheckSumm(uint8_t *cMessage, uint8_t cMesLen);
 extern void boardSetup(void);
 extern void calcSenAddr(uint8_t);
 extern void printSensorData(uint8_t);
 extern void lnDecodeMessage(lnMsg *LnPacket);
-extern void buildLnMessage(MFRC522, uint8_t , uint8_t );
+extern void buildLnMessage(const MFRC522::Uid &uid, uint8_t port, lnMsg *pMsg);
 extern void varInit(void);
 
+extern void svMirrorInit(void);
+extern uint8_t svRead(uint16_t offset);
+extern void svWrite(uint16_t offset, uint8_t value);
+extern boolean svFlush(void);
+extern void svApplyChanges(void);
+
+extern uint8_t svMirror[];
+extern uint8_t svDirty[];
+extern uint16_t uiPortsChanged;
+
+/*
+ * Single producer / single consumer ring for the messages sent in the LocoNet bus.
+ * The indexes are free running (the slot is index & LN_BUFF_MASK), each one written by
+ * only one side, so the producer can also run in an ISR.
+ * With LN_BUFF_COALESCE, a new message of a port overwrites the port message still waiting
+ * in the ring (never the one at tail, which can be in sending), so the ring holds maximal
+ * one message per port plus the one in sending. The producer must then run in loop().
+ */
+typedef struct {
+  lnMsg            msg[LN_BUFF_LEN];
+  volatile uint8_t head;      //next slot to write; changed only by the producer
+  volatile uint8_t tail;      //next slot to send; changed only by the consumer
+  uint8_t          wrIdx;     //slot returned by the last lnRingAlloc()
+  uint8_t          highWater; //maximal number of messages waiting in the ring
+  uint16_t         overflows; //messages dropped because the ring was full
+#if LN_BUFF_COALESCE
+  uint8_t          slotPort[LN_BUFF_LEN];         //port of the message in each slot
+  uint8_t          pending[NR_OF_RFID_PORTS];     //index of the last message queued for each port
+  uint16_t         coalesced; //messages replaced by a newer message of the same port
+#endif
+  uint32_t         tagTime[LN_BUFF_LEN]; //micros() of the tag read; 0 for non tag messages
+} __lnRingType;
+
+static_assert((LN_BUFF_LEN & LN_BUFF_MASK) == 0, "LN_BUFF_LEN must be a power of 2");
+static_assert(LN_BUFF_LEN <= 128, "LN_BUFF_LEN must fit the 8 bit ring indexes");
+
+/* compiler barrier: the message content is written / read before the index is changed*/
+#define LN_RING_BARRIER()   __asm__ __volatile__("" ::: "memory")
+
+extern __lnRingType lnTxRing;
+
+extern uint8_t lnRingCount(void);
+extern lnMsg *lnRingAlloc(uint8_t port);
+extern lnMsg *lnRingAppend(uint8_t port);
+extern void lnRingCommit(void);
+extern lnMsg *lnRingPeek(void);
+extern void lnRingRelease(void);
+
+/*
+ * Non blocking transmitter: the carrier detect / priority backoff of the LocoNet library is
+ * polled with sendLocoNetPacketTry() once per loop() pass, so the readers and the LocoNet
+ * reception keep running while the bus is busy. Two priority classes: the SV replies (own
+ * small queue) are sent before the sensor / UID messages of lnTxRing.
+ */
+#define LN_TX_IDLE      0    /* nothing in sending*/
+#define LN_TX_SV        1    /* SV reply in sending*/
+#define LN_TX_SENSOR    2    /* lnTxRing message in sending*/
+
+typedef struct {
+  lnMsg    svMsg[LN_SV_BUFF_LEN]; //SV replies waiting to be sent
+  uint8_t  svHead;          //free running indexes of svMsg
+  uint8_t  svTail;
+  uint8_t  state;           //LN_TX_IDLE / LN_TX_SV / LN_TX_SENSOR
+  uint8_t  prioDelay;       //priority delay of the current attempt; lowered after each failed attempt
+  uint8_t  tries;           //failed attempts of the message in sending
+  boolean  bWaitBackoff;    //LN_NETWORK_BUSY before the first backoff is not a failed attempt
+} __lnTxType;
+
+static_assert((LN_SV_BUFF_LEN & LN_SV_BUFF_MASK) == 0, "LN_SV_BUFF_LEN must be a power of 2");
+
+extern __lnTxType lnTx;
+
+extern lnMsg *lnTxSvAlloc(void);
+extern void lnTxSvCommit(void);
+extern void lnTxProcess(void);
+
+#if PERF_MEASURE
+  typedef struct {
+    uint32_t windowStart; //millis() at the start of the measurement window
+    uint32_t loopCnt;     //loop() passes in the current window
+    uint32_t rdrCalls;    //MFRC522 library calls in the current window; each one is at least one SPI transaction
+    uint32_t latSum;      //sum of the tag to LocoNet.send() latencies (us)
+    uint32_t latMax;      //worst tag to LocoNet.send() latency (us)
+    uint16_t latCnt;      //number of tag messages sent in the current window
+  } __perfType;
+
+  extern __perfType perfData;
+  extern void perfReport(void);
+#endif
+
+
+#if DBG_LOG
+/*
+ * Deferred debug log: the hot path only copies a binary event in a small ring (O(1), nothing
+ * if Serial is not connected); dbgLogDrain() prints maximal one event per call, when the loop
+ * has nothing to send. Events not fitting in the ring are counted and reported.
+ */
+  #define DBG_LOG_LEN      8    /* power of 2*/
+  #define DBG_LOG_MASK     (DBG_LOG_LEN - 1)
+
+  #define DBG_EV_TAG       1    /* tag reported; data = UID*/
+  #define DBG_EV_FREE      2    /* port reported free*/
+  #define DBG_EV_LN_TX     3    /* message sent; data = first message bytes (_SER_DEBUG)*/
+  #define DBG_EV_LN_DROP   4    /* message dropped after LN_TX_TRIES attempts; data = first message bytes*/
+  #define DBG_EV_SV        5    /* SV request answered; data = SV command, SV index low, high*/
+
+  #define DBG_SV_LEN       3    /* data bytes of DBG_EV_SV*/
+
+  typedef struct {
+    uint32_t time;            //millis() of the event
+    uint8_t  code;            //DBG_EV_xxx
+    uint8_t  port;            //reader; LN_NO_PORT if none
+    uint8_t  len;             //valid bytes in data
+    uint8_t  data[UID_LEN];
+  } __dbgEventType;
+
+  typedef struct {
+    __dbgEventType ev[DBG_LOG_LEN];
+    uint8_t  head;            //free running indexes
+    uint8_t  tail;
+    uint16_t dropped;         //events lost since the last report
+  } __dbgLogType;
+
+  static_assert((DBG_LOG_LEN & DBG_LOG_MASK) == 0, "DBG_LOG_LEN must be a power of 2");
+
+  extern void dbgLog(uint8_t code, uint8_t port, const uint8_t *pData, uint8_t len);
+  extern void dbgLogDrain(void);
+#else
+  #define dbgLog(code, port, pData, len)
+#endif
+
+extern uint8_t nextReader(uint8_t port);
+extern void readerNewTag(uint8_t port);
+extern void readerCheckPresence(uint8_t port);
+extern void readerFreeReport(uint8_t port);
+extern void queueTagReport(uint8_t port, uint32_t ulReadTime);
+extern void queueSensorState(uint8_t port, boolean bOccupied);
+extern void speedTagSeen(uint8_t port, uint32_t ulReadTime);
+
+extern void rfidReaderAttach(uint8_t port, uint8_t ssPin, uint32_t ulClock);
+extern void rfidReaderInit(uint8_t port, uint8_t ssPin, uint32_t ulClock);
+extern void rfidReaderConfig(uint8_t port);
+extern uint8_t rfidReaderProbe(uint8_t port);
+extern void rfidResetAll(void);
+extern void readerActivate(uint8_t port, uint8_t ucVer);
+extern void readerDeactivate(uint8_t port);
+extern void readerHealthProcess(void);
+extern void rfidReaderReset(uint8_t port);
+extern boolean rfidReaderInReset(uint8_t port);
+extern void readerBootProcess(void);
+extern void readerProbeProcess(void);
+extern void serialAttach(void);
+extern void printBoardInfo(void);
+extern void rfidSpiRelease(void);
+extern void rfidWriteRegs(uint8_t port, const uint8_t *pRegVal, uint8_t n);
+extern void rfidReadRegs(uint8_t port, const uint8_t *pRegs, uint8_t n, uint8_t *pOut);
+extern boolean rfidRequest(uint8_t port, uint8_t ucCmd);
+extern void rfidHalt(uint8_t port);
 
 #if USE_INTERRUPTS
-  extern void activateRec(MFRC522 mfrc522);
-  extern void clearInt(MFRC522 mfrc522);
-  extern void readCard1(void);
-  extern void readCard2(void);
-  extern volatile boolean bNewInt[];
+  extern void activateRec(uint8_t port);
+  extern void attachReaderIsr(uint8_t port, uint8_t pin);
+  extern void rearmReader(uint8_t port);
   extern unsigned char regVal;
+  extern const byte mfrc522Irq[];
+#endif
 
-  typedef void (*readCardIntArray) (void);
-  extern readCardIntArray readCardInt[];
+/*
+ * The state of one RFID reader. All the per reader data is kept here, so a new reader
+ * costs only one more entry in rfidPorts[]
+ */
+typedef struct {
+  uint8_t  oldUid[UID_LEN]; //last reported UID
+  uint8_t  presState;       //PRES_FREE / PRES_PRESENT / PRES_HELD
+#if MULTI_TAG_MODE
+  uint8_t  knownUid[MULTI_TAG_MAX][UID_LEN]; //UIDs reported since the port became occupied
+  uint8_t  knownNext;       //next knownUid[] entry to (over)write
+#endif
+  uint32_t lastSeen;        //millis() of the last answer of the reported tag
+  uint32_t freeTime;        //millis() when the tag was missed for the hold-off time
+  uint8_t  addrHiSen;       //sensor address high
+  uint8_t  addrLoSen;       //sensor address low
+  uint16_t addrSenFull;
+  uint8_t  senType;         //input
+  uint8_t  lnHdr[LN_UID_HDR_LEN]; //prebuilt header of the 0xE4 UID message
+  uint8_t  lnHdrChk;        //check summ of lnHdr, start value for the message check summ
+  boolean  bActive;         //reader in the round robin: detected, health check passed
+  boolean  bFailed;         //dropped by the health check, not answering yet
+  uint32_t failTime;        //millis() of the health check failure
+#if UID_TABLE
+  uint16_t locoAddr;        //loco address of the reported tag; 0 = not in the UID table
+#endif
+  SPISettings spiSettings;  //SPI clock / mode of the reader
+  uint8_t  ssPin;           //SS pin of the reader
+  boolean  bSpiDedicated;   //reader alone on its bus (RFID_SPI_DEDICATED)
+#if PERF_MEASURE
+  uint32_t spiTrans;        //SPI transactions of the detection path
+  uint32_t spiBytes;        //SPI bytes of the detection path
 #endif
+#if USE_INTERRUPTS
+  volatile boolean bNewInt; //set by the reader ISR
+  volatile uint32_t intTime; //micros() of the first reader interrupt after the rearm (tag answer), set by the ISR
+  uint32_t rearmTime;       //millis() of the last REQA sent by the reader
+#endif
+} __rfidPortType;
+
+extern __rfidPortType rfidPorts[];
+extern MFRC522 mfrc522[];
+extern uint8_t uiActReaders;
+extern uint8_t uiFirstReaderIdx;
+extern uint8_t uiRfidPort;
+extern boolean bRfidBoot;
+extern uint32_t ulRfidResetTime;
 
 extern uint8_t boardVer[];
 extern char verLen;
 
 extern LocoNetSystemVariableClass sv;
 extern lnMsg       *LnPacket;
-extern lnMsg       SendPacket ;
-extern lnMsg       SendPacketSensor[] ;
 extern SV_STATUS   svStatus;
 extern boolean     deferredProcessingNeeded;
+extern lnMsg       DeferredPacket;
+extern uint32_t    ulDeferredTime;
+extern uint8_t     uiSenQueryPort;
+extern uint32_t    ulSenQueryTime;
 
 extern uint8_t ucBoardAddrHi;  //board address high; always 1
 extern uint8_t ucBoardAddrLo;  //board address low; default 88
 
-extern uint8_t ucAddrHiSen[];    //sensor address high
-extern uint8_t ucAddrLoSen[];    //sensor address low
-extern uint8_t ucSenType[]; //input
-extern uint16_t uiAddrSenFull[];
-
 extern uint8_t uiLnSendCheckSumIdx;
 extern uint8_t uiLnSendLength; //14 bytes
 extern uint8_t uiLnSendMsbIdx;
-extern uint8_t uiStartChkSen;
-
-extern uint8_t oldUid[][UID_LEN];
 
 extern boolean bSerialOk;
 
-extern uint8_t uiNrEmptyReads[]; 
 
+/*
+ * Output ports: the ports after the readers with the port type (LocoIO SV 3 + 3 * port)
+ * OUT_PORT_TYPE, driven by OPC_SW_REQ. Port SV 1 / SV 2 as the OPC_SW_REQ SW1 / SW2:
+ * switch address - 1 = (SV2 & 0x0F) << 7 | SV1, SV2 & 0x20 = the direction turning the pin on
+ * (0x20 closed, 0 thrown). outHash[] indexes outputs[] by the switch address.
+ */
+#define OUT_PORT_TYPE   0x10
+#define OUT_HASH_LEN    16    /* power of 2, more than the number of outputs*/
+#define OUT_HASH_MASK   (OUT_HASH_LEN - 1)
+
+/* OPC_SW_STATE reply: OPC_LONG_ACK <OPC_SW_STATE & 0x7F> <ACK1>, ACK1 bit 5 = closed (as JMRI reads it)*/
+#define OUT_ACK_THROWN  0x10
+#define OUT_ACK_CLOSED  0x30
 
 typedef struct {
-  uint16_t addr;
-  uint8_t  state;
-  uint8_t  idx;
+  uint16_t addr;   //switch address
+  uint8_t  state;  //pin level
+  uint8_t  idx;    //port
+  uint8_t  pin;
+  uint8_t  dir;    //direction turning the pin on (OPC_SW_REQ DIR bit)
 } __outType;
 
+static_assert(TOTAL_NR_OF_PORTS - NR_OF_RFID_PORTS < OUT_HASH_LEN, "OUT_HASH_LEN must be bigger than the number of outputs");
+
 extern __outType outputs[];
 extern uint8_t outsNr;
 extern boolean bUpdateOutputs;
+extern const byte outPins[];
+extern const uint8_t outPinsNr;
+
+extern void outputsInit(void);
+extern void outputsSwMessage(lnMsg *LnPacket);
+
+#if UID_TABLE
+/*
+ * UID -> loco address table. The entries (UID zero filled to UID_LEN, loco address low / high)
+ * are kept in EEPROM after the SV storage and the board signature; the number of entries
+ * in the first byte. The RAM index holds the UID hash and the EEPROM slot of each entry,
+ * sorted by hash => binary search, only the matching entry is read from EEPROM.
+ */
+  #define UIDTAB_EE_BASE    256   /* EEPROM address of the number of entries; the entries follow*/
+  #define UIDTAB_ENTRY_LEN  (UID_LEN + 2)
+  #define UIDTAB_MAX        48    /* 3 bytes RAM per entry*/
+  #define UIDTAB_WQ_LEN     32    /* EEPROM writes of the table waiting for the idle time; 3 bytes RAM each*/
+
+  typedef struct {
+    uint16_t hash;
+    uint8_t  slot;   //entry position in EEPROM
+  } __uidIdxType;
+
+  typedef struct {
+    uint16_t addr;
+    uint8_t  value;
+  } __uidEeWriteType;
+
+  extern void uidTabInit(void);
+  extern uint16_t uidTabLookup(const uint8_t *pUid);
+  extern boolean uidTabSet(const uint8_t *pUid, uint16_t uiLoco);
+  extern boolean uidTabDelete(const uint8_t *pUid);
+  extern void uidTabClear(void);
+  extern boolean uidTabFlush(void);
+  extern uint16_t uidTabRead(uint8_t slot, uint8_t *pUid);
+  extern void queueTranspAbsent(uint8_t port);
+  extern uint8_t uidTabCnt;
+
+  static_assert(UIDTAB_EE_BASE + UIDTAB_MAX * UIDTAB_ENTRY_LEN <= E2END, "the UID table doesn't fit in EEPROM");
+#endif
+
+/*
+ * Runtime counters, cheap enough to stay always active. Read as LocoIO SVs SV_STAT_BASE..
+ * (LNSV2 SV + 7), 16 bit values low byte first; a write of any of these SVs clears all of them.
+ */
+#define SV_STAT_BASE    128
+
+typedef struct {
+  uint16_t loopsPerSec;    //loop() passes in the last second
+  uint16_t ringHighWater;  //maximal number of messages waiting to be sent
+  uint16_t ringOverflows;  //messages dropped because the send ring was full
+  uint16_t latMax;         //worst tag read to LocoNet.send() latency, 100 us units
+  uint16_t eeWrites;       //EEPROM writes
+  uint16_t sendStatus[LN_RETRY_ERROR + 1]; //LocoNet.send() results, by LN_STATUS
+  uint16_t healthUsMax;    //worst duration of one reader health check, us
+  uint16_t recoveryMax;    //worst time out of service of a failed reader, 100 ms units
+  struct {
+    uint16_t detections;   //tags read
+    uint16_t resets;       //reader (re)initialisations after startup
+    uint16_t failures;     //health check failures
+  } reader[NR_OF_RFID_PORTS];
+} __statsType;
+
+#define SV_STAT_LEN     sizeof(__statsType)
+
+extern __statsType stats;
+extern void statsReset(void);
+extern void statsLoop(void);
+extern uint8_t statsRead(uint8_t idx);
+
+static_assert(SV_PORTS_END <= SV_CFG_BASE, "the ports table overlaps the board configuration");
+static_assert(SV_CFG_END <= SV_USER_LEN, "the board configuration must fit in the SV mirror");
+static_assert(SV_STAT_BASE >= SV_USER_LEN, "the counters overlap the SV mirror");
+static_assert(SV_ADDR_USER_BASE + SV_STAT_BASE + SV_STAT_LEN - 1 <= SV_MAX_READ, "the counters must be readable as LNSV2 SVs");
 
 #endif //ifndef RFID2LN_H_
 
@@ -19,6 +19,8 @@
  * RST/Reset   RST          9             5         D9         RESET/ICSP-5     RST
  * SPI SS 1    SDA(SS)      10            53        D10        5                ?
  * SPI SS 2    SDA(SS)      7             53        D7         3                ?
+ * IRQ_1       IRQ          2             ?         2          2                ?
+ * IRQ_2       IRQ          3             ?         3          3                ?
  * SPI MOSI    MOSI         11 / ICSP-4   51        D11        ICSP-4           ?
  * SPI MISO    MISO         12 / ICSP-1   50        D12        ICSP-1           ?
  * SPI SCK     SCK          13 / ICSP-3   52        D13        ICSP-3           ?
@@ -47,79 +49,86 @@
 MFRC522 mfrc522[NR_OF_RFID_PORTS];
 #if NR_OF_RFID_PORTS == 1
 uint8_t boardVer[] = "RFID2LN Vxx SINGLE";
-#elif NR_OF_RFID_PORTS == 2
+#else
 uint8_t boardVer[] = "RFID2LN Vxx MULTI";
 #endif
 char verLen = sizeof(boardVer);
 
 LocoNetSystemVariableClass sv;
 lnMsg       *LnPacket;
-lnMsg       SendPacket ;
-lnMsg       SendPacketSensor[LN_BUFF_LEN] ;
+__lnRingType lnTxRing; //the sensor messages waiting to be sent
+__lnTxType  lnTx;      //the transmitter state and the SV replies waiting to be sent
 
 SV_STATUS   svStatus = SV_OK;
-boolean     deferredProcessingNeeded = false;
+boolean     deferredProcessingNeeded = false; //a LNSV2 discover reply waits for its slot
+lnMsg       DeferredPacket;                   //the discover reply
+uint32_t    ulDeferredTime;                   //millis() when the discover reply is sent
+uint8_t     uiSenQueryPort = LN_NO_PORT;      //next reader of the sensor query report; LN_NO_PORT = no query
+uint32_t    ulSenQueryTime;                   //millis() when the sensor query report starts
 
 uint8_t ucBoardAddrHi = 1;  //board address high; always 1
 uint8_t ucBoardAddrLo = 88;  //board address low; default 88
 
-uint8_t ucAddrHiSen[NR_OF_RFID_PORTS];    //sensor address high
-uint8_t ucAddrLoSen[NR_OF_RFID_PORTS];    //sensor address low
-uint8_t ucSenType[NR_OF_RFID_PORTS]; //input
-uint16_t uiAddrSenFull[NR_OF_RFID_PORTS];
+__rfidPortType rfidPorts[NR_OF_RFID_PORTS];
 
 uint8_t uiLnSendCheckSumIdx = 13;
 uint8_t uiLnSendLength = 14; //14 bytes
 uint8_t uiLnSendMsbIdx = 12;
-uint8_t uiStartChkSen;
-
-uint8_t oldUid[NR_OF_RFID_PORTS][UID_LEN]; 
 
 boolean bSerialOk = false;
 
-byte mfrc522Cs[] = {SS_1_PIN, SS_2_PIN};
+const byte mfrc522Cs[] PROGMEM = RFID_SS_PINS;
+static_assert(sizeof(mfrc522Cs) >= NR_OF_RFID_PORTS, "RFID_SS_PINS needs one SS pin per reader");
+const uint32_t mfrc522SpiClk[] PROGMEM = RFID_SPI_CLOCKS;
 
-#if USE_INTERRUPT
-  byte mfrc522Irq[] = {IRQ_1_PIN, IRQ_2_PIN};
+#if USE_INTERRUPTS
+  const byte mfrc522Irq[] PROGMEM = RFID_IRQ_PINS;
+  static_assert(sizeof(mfrc522Irq) >= NR_OF_RFID_PORTS, "RFID_IRQ_PINS needs one IRQ pin per reader");
 #endif
 
-uint8_t uiBufWrIdx = 0;
-uint8_t uiBufRdIdx = 0;
-uint8_t uiBufCnt = 0;
-
 __outType outputs[TOTAL_NR_OF_PORTS - NR_OF_RFID_PORTS]; /*maximum number of outputs*/
 uint8_t outsNr = 0;
 boolean bUpdateOutputs = false;
+const byte outPins[] PROGMEM = OUT_PINS;  //pin of each port after the readers
+const uint8_t outPinsNr = sizeof(outPins);
 
 uint8_t uiRfidPort = 0;
 
-uint8_t uiNrEmptyReads[NR_OF_RFID_PORTS]; 
-
 uint8_t uiActReaders = 0;
 uint8_t uiFirstReaderIdx = 0;
+boolean bRfidBoot = false;                //FAST_BOOT: the readers are not detected yet
+uint32_t ulRfidResetTime;                 //FAST_BOOT: millis() of the common reset of the readers
 
-#if USE_INTERRUPTS
-volatile boolean bNewInt[NR_OF_RFID_PORTS];
-unsigned char regVal = 0x7F;
-void activateRec(MFRC522 mfrc522);
-void clearInt(MFRC522 mfrc522);
+uint8_t svMirror[SV_MIRROR_LEN];          //RAM copy of the SV storage
+uint8_t svDirty[SV_DIRTY_LEN];            //SVs changed in RAM, not yet written in EEPROM
+uint16_t uiPortsChanged = 0;              //readers whose SVs changed => sensor address to recalculate
+
+__statsType stats;                        //runtime counters, readable as SVs
 
-readCardIntArray readCardInt[] = {readCard1, readCard2};
+#if PERF_MEASURE
+__perfType perfData;
+#endif
+
+#if USE_INTERRUPTS
+unsigned char regVal = 0xA0; //IRqInv + RxIEn: only the tag answer pulls the IRQ pin low
 #endif
 
 /**
  * Initialize.
  */
 void setup() {
+  varInit();
+
+  Serial.begin(115200); // Initialize serial communications with the PC
+#if FAST_BOOT
+  /* no wait for the serial interface; it is attached later by loop() (serialAttach)*/
+#else
   uint32_t uiStartTimer;
   uint16_t uiElapsedDelay;
   uint16_t uiSerialOKDelay = 5000;
 
-  varInit();
-
-  Serial.begin(115200); // Initialize serial communications with the PC
   uiStartTimer = millis();
-  do { //wait for the serial interface, but maximal 1 second.
+  do { //wait for the serial interface, but maximal 5 seconds.
     uiElapsedDelay = millis() - uiStartTimer;
   } while ((!Serial) && (uiElapsedDelay < uiSerialOKDelay));    // Do nothing if no serial port is opened (added for Arduinos based on ATMEGA32U4)
 
@@ -127,10 +136,11 @@ void setup() {
     bSerialOk = true;
     Serial.println(F("************************************************"));
   }
+#endif
 
   //initialize the LocoNet interface
   LocoNet.init(LN_TX_PIN); //Always use the explicit naming of the Tx Pin to avoid confusions
-  sv.init(MANUF_ID, BOARD_TYPE, 1, 1); //to see if needed just once (saved in EEPROM)
+  sv.init(MANUF_ID, BOARD_TYPE, PRODUCT_ID, SW_VERSION); //to see if needed just once (saved in EEPROM)
 
 #if EE_ERASE
   for (uint8_t i = 0; i < verLen; i++) {
@@ -139,65 +149,50 @@ void setup() {
 #endif
 
   boardSetup();
-
-  SPI.begin();        // Init SPI bus
-  //  SPI.beginTransaction(SPISettings(8000000, MSBFIRST, SPI_MODE0)); //spi speed of MFRC522 - 10 MHz
-
-#if USE_INTERRUPT
-  regVal = 0xA0; //rx irq
+  svMirrorInit();
+  outputsInit();      //the output pins, from the port SVs
+#if UID_TABLE
+  uidTabInit();
 #endif
+  randomSeed(svRead(SV_ADDR_SERIAL_NUMBER_L) | (svRead(SV_ADDR_SERIAL_NUMBER_H) << 8)); //different discover slots per board
 
+  SPI.begin();        // Init SPI bus; the bus settings are set per reader access (RFID_SPI_CLOCKS)
+
+#if FAST_BOOT
+  /*
+   * one common reset; the readers are detected by loop() (readerBootProcess) when their
+   * oscillators run, the LocoNet is served meanwhile
+   */
+  for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) { 
+    uint32_t ulClock = (i < (sizeof(mfrc522SpiClk) / sizeof(mfrc522SpiClk[0]))) ? pgm_read_dword(&mfrc522SpiClk[i]) : RFID_SPI_CLOCK_DEF;
+    rfidReaderAttach(i, pgm_read_byte(&mfrc522Cs[i]), ulClock);
+  }
+  rfidResetAll();
+  bRfidBoot = true;
+#else
   /*
    * only initialisation; all reader should be initialised before
    * any communication
    */                                                  
   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) { 
-    mfrc522[i].PCD_Init(mfrc522Cs[i], RST_PIN);
+    uint32_t ulClock = (i < (sizeof(mfrc522SpiClk) / sizeof(mfrc522SpiClk[0]))) ? pgm_read_dword(&mfrc522SpiClk[i]) : RFID_SPI_CLOCK_DEF;
+    rfidReaderInit(i, pgm_read_byte(&mfrc522Cs[i]), ulClock);
   }
     
   /* detect the active readers. If version read != 0xFF => reader active*/
   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
-    byte readReg = mfrc522[i].PCD_ReadRegister(mfrc522[i].VersionReg);
-    
-    if (bSerialOk) {
-      Serial.print(F("Reader "));
-      Serial.print(i+1);
-    }
+    uint8_t ucVer = rfidReaderProbe(i);
 
-    if((readReg == 0x00) || (readReg == 0xFF)){ //missing reader
+    if (ucVer == 0) { //missing reader
+      svWrite(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + i, 0);
       if (bSerialOk) {
+        Serial.print(F("Reader "));
+        Serial.print(i+1);
         Serial.println(F(" absent"));
       }
     } else {
-      if (bSerialOk) {
-        Serial.print(F(" present; version = "));
-        Serial.println(readReg, HEX);
-      }
-      if(0 == uiActReaders){ //save the number of the first active reader
-         uiFirstReaderIdx = i;
-         uiRfidPort = uiFirstReaderIdx; //initialize the starting reader counter
-      }
-      uiActReaders++;
-      calcSenAddr(i);
-
-#if USE_INTERRUPT
-      pinMode(mfrc522Irq[i], INPUT_PULLUP);
-
-      /* 
-       *  Allow the ... irq to be propagated to the IRQ pin
-       *  For test purposes propagate the IdleIrq and loAlert
-       */
-      mfrc522[i].PCD_WriteRegister(mfrc522[i].ComIEnReg,regVal);
-
-      delay(10);
-      attachInterrupt(digitalPinToInterrupt(mfrc522Irq[i]), readCard[i](), FALLING);
-      bNewInt[i] = false;
-#endif
-
-      if (bSerialOk) {
-        printSensorData(i);
-      }
-    } //if(readReg)
+      readerActivate(i, ucVer);
+    }
   } //for(uint8_t i = 0
   
   if (bSerialOk) {
@@ -205,6 +200,9 @@ void setup() {
     Serial.println(uiActReaders);
     Serial.println(F("************************************************"));
   }
+#endif
+
+  statsReset(); //count from the end of the startup
 }
 
 
@@ -213,112 +211,89 @@ void setup() {
  * Main loop.
  */
 void loop() {
+  statsLoop();
+#if PERF_MEASURE
+  perfData.loopCnt++;
+#endif
+
+#if FAST_BOOT
+  if (bRfidBoot) {
+    readerBootProcess();
+  }
+#endif
+
   /*************
    * Read the TAGs
    */
-  //  for (uint8_t port = 0; port < NR_OF_RFID_PORTS; port++) {
   if (uiActReaders > 0) {
-    if (uiBufCnt < LN_BUFF_LEN) { //if buffer not full
-#if USE_INTERRUPT
-      if(bNewInt[uiRfidPort]){
-        bNewInt[uiRfidPort] = false;
+    if (lnRingCount() < LN_BUFF_LEN) { //if buffer not full
+#if USE_INTERRUPTS
+      for (uint8_t i = 0; i < uiActReaders; i++) { //jump to the next reader that signalled a tag
+        if (rfidPorts[uiRfidPort].bNewInt) {
+          break;
+        }
+        uiRfidPort = nextReader(uiRfidPort);
+      }
+
+      if (rfidPorts[uiRfidPort].bNewInt) { //a tag answered the REQA
+        readerNewTag(uiRfidPort);
+        rearmReader(uiRfidPort);
+      } else if ((millis() - rfidPorts[uiRfidPort].rearmTime) >= IRQ_REARM_PERIOD) {
+        /* 
+         * No interrupt since the last REQA => no new tag. Idle readers cost no SPI 
+         * traffic until the next REQA is due.
+         */
+        readerCheckPresence(uiRfidPort);
+        rearmReader(uiRfidPort);
+      }
 #else
-      if(mfrc522[uiRfidPort].PICC_IsNewCardPresent()) {
-#endif
-        if (mfrc522[uiRfidPort].PICC_ReadCardSerial()) { //if tag data
-          if (uiNrEmptyReads[uiRfidPort] > 2) { //send an uid only once
-            // Show some details of the PICC (that is: the tag/card)
-            if (bSerialOk) {
-              Serial.print(F("Port: "));
-              Serial.print(uiRfidPort);
-              Serial.print(F(" Card UID:"));
-              dump_byte_array(mfrc522[uiRfidPort].uid.uidByte, mfrc522[uiRfidPort].uid.size);
-              Serial.println();
-            }
-
-            buildLnMessage(mfrc522[uiRfidPort],uiRfidPort, uiBufWrIdx); 
-
-            if (uiBufWrIdx < LN_BUFF_LEN) {
-              uiBufWrIdx++;
-            } else {
-              uiBufWrIdx = 0;
-            }
-            uiBufCnt++;
-
-            copyUid(mfrc522[uiRfidPort].uid.uidByte, oldUid[uiRfidPort], mfrc522[uiRfidPort].uid.size);
-          } //if(uiNrEmptyReads[uiRfidPort] > ...){          
-
-          uiNrEmptyReads[uiRfidPort] = 0;
-
-        } //if(mfrc522[uiRfidPort].PICC_ReadCardSerial())
-
-#if USE_INTERRUPT
-        clearInt(mfrc522[uiRfidPort]);
-        activateRec(mfrc522[uiRfidPort]); //rearm the reading part of the mfrc522
-#endif          
-      } else { //if newCard / newInt
-        /* Reset the sensor indication in Rocrail => RFID can be used as a normal sensor*/
-        boolean rc = mfrc522[uiRfidPort].PICC_ReadCardSerial();
-        if (!rc) {
-          if (/*bSendReset[uiRfidPort] &&*/ (uiNrEmptyReads[uiRfidPort] == MAX_EMPTY_READS)) {
-//            if (bSerialOk) {
-//              Serial.println(F("Send reset: "));
-//            }
-            uint16_t uiAddr =  (uiAddrSenFull[uiRfidPort] - 1) / 2;
-            SendPacketSensor[uiBufWrIdx].data[0] = 0xB2;
-            SendPacketSensor[uiBufWrIdx].data[1] = uiAddr & 0x7F; //ucAddrLoSen;
-            SendPacketSensor[uiBufWrIdx].data[2] = ((uiAddr >> 7) & 0x0F) | 0x40; //ucAddrHiSen & 0xEF;
-            if ((uiAddrSenFull[uiRfidPort] & 0x01) == 0) {
-              SendPacketSensor[uiBufWrIdx].data[2] |= 0x20;
-            }
-            SendPacketSensor[uiBufWrIdx].data[3] = lnCalcCheckSumm(SendPacketSensor[uiBufWrIdx].data, 3);
-
-            if (uiBufWrIdx < LN_BUFF_LEN) {
-              uiBufWrIdx++;
-            } else {
-              uiBufWrIdx = 0;
-            }
-            uiBufCnt++;
-          
-          } //if(bSendReset
-
-          if (uiNrEmptyReads[uiRfidPort] <= (MAX_EMPTY_READS + 1)) {
-            uiNrEmptyReads[uiRfidPort]++;
-          }
-        } //if (!mfrc522.PICC_
-      }   // else if ( mfrc522.PICC_IsNewCardPresent()  
-
-      uiRfidPort++;
-      if (uiRfidPort == uiActReaders + uiFirstReaderIdx) {
-        uiRfidPort = uiFirstReaderIdx;
+      if (rfidRequest(uiRfidPort, MFRC522::PICC_CMD_REQA)) { //a tag answered the REQA => new tag
+        readerNewTag(uiRfidPort);
+      } else {
+        readerCheckPresence(uiRfidPort);
       }
-    } //if(uiBufCnt < LN_BUFF_LEN){
-  } //if(NR_OF_RFID_PORTS
+#endif
+
+      uiRfidPort = nextReader(uiRfidPort);
+    } //if(lnRingCount() < LN_BUFF_LEN){
+  } //if(uiActReaders > 0)
+
+  /******
+   * one reader health check, at the SV_CFG_HEALTH rate
+   */
+  readerHealthProcess();
 
   /******
-   * send the tag data in the loconet bus
+   * send the SV replies and the tag data in the loconet bus; one step per pass
    */
-  if (uiBufCnt > 0) {
+  lnTxProcess();
 
-#ifdef _SER_DEBUG
+  /************
+   * Nothing to send => time to attach the Serial, print the debug log, write the changed SVs (and UID table)
+   * in EEPROM and look for new readers
+   */
+  if ((lnRingCount() == 0) && (lnTx.state == LN_TX_IDLE)) {
+#if FAST_BOOT
+    if (!bSerialOk) {
+      serialAttach();
+    }
+#endif
+#if DBG_LOG
     if (bSerialOk) {
-      Serial.print(F("LN send mess:"));
-      dump_byte_array(SendPacketSensor[uiBufRdIdx].data, uiLnSendLength);
-      Serial.println();
+      dbgLogDrain();
     }
 #endif
-
-    LN_STATUS lnSent = LocoNet.send( &SendPacketSensor[uiBufRdIdx], LN_BACKOFF_MAX - (ucBoardAddrLo % 10));   //trying to differentiate the ln answer time
-
-    if (lnSent = LN_DONE) { //message sent OK
-      if (uiBufRdIdx < LN_BUFF_LEN) {
-        uiBufRdIdx++;
-      } else {
-        uiBufRdIdx = 0;
-      }
-      uiBufCnt--;
-    } //if(lnSent = LN_DONE)
-  } //if(uiBufCnt > 0){
+#if UID_TABLE
+    if (!svFlush()) {
+      uidTabFlush();
+    }
+#else
+    svFlush();
+#endif
+    if (!bRfidBoot) {
+      readerProbeProcess(); //hot plugged readers
+    }
+  }
 
   /************
    * Addresses programming over loconet
@@ -328,5 +303,17 @@ void loop() {
   if ( LnPacket) { //new message sent by other
     lnDecodeMessage(LnPacket);
   }//if( LnPacket)
+
+  if (deferredProcessingNeeded) {
+    sv2DeferredProcessing();
+  }
+
+  if (uiSenQueryPort != LN_NO_PORT) {
+    senQueryProcess();
+  }
+
+#if PERF_MEASURE
+  perfReport();
+#endif
 }
 
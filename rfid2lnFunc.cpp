@@ -44,17 +44,23 @@ void copyUid (byte *buffIn, byte *buffOut, byte bufferSize) {
     }
 }
 
-void setMessageHeader(uint8_t port, uint8_t index){
+/**
+ * Prebuild the header of the port UID message and its check summ. Called only when the
+ * sensor address of the port is (re)calculated
+ */
+void setMessageHeader(uint8_t port){
     unsigned char k = 0;
-    SendPacketSensor[index].data[0] = 0xE4; //OPC - variable length message 
-    SendPacketSensor[index].data[1] = uiLnSendLength; //14 bytes length
-    SendPacketSensor[index].data[2] = 0x41; //report type 
-    SendPacketSensor[index].data[3] = ucAddrHiSen[port]; //sensor address high
-    SendPacketSensor[index].data[4] = ucAddrLoSen[port]; //sensor address low 
+    uint8_t *pHdr = rfidPorts[port].lnHdr;
+
+    pHdr[0] = 0xE4; //OPC - variable length message 
+    pHdr[1] = uiLnSendLength; //14 bytes length
+    pHdr[2] = 0x41; //report type 
+    pHdr[3] = rfidPorts[port].addrHiSen; //sensor address high
+    pHdr[4] = rfidPorts[port].addrLoSen; //sensor address low 
     
-    SendPacketSensor[index].data[uiLnSendCheckSumIdx]=0xFF;
-    for(k=0; k<5;k++){
-      SendPacketSensor[index].data[uiLnSendCheckSumIdx] ^= SendPacketSensor[index].data[k];
+    rfidPorts[port].lnHdrChk = 0xFF;
+    for(k=0; k<LN_UID_HDR_LEN;k++){
+      rfidPorts[port].lnHdrChk ^= pHdr[k];
     }
 }
 
@@ -107,26 +113,24 @@ uint8_t processXferMess(lnMsg *LnRecMsg, lnMsg *cOutBuf){
                 cOutBuf->data[0x0B] = 0x7F;
                 ucBoardAddrLo = ucPeerRSvValue;
                 cOutBuf->data[0x0E] = ucPeerRSvValue;
-                sv.writeSVStorage(SV_ADDR_NODE_ID_L, ucPeerRSvValue); //save the new value
+                svWrite(SV_ADDR_NODE_ID_L, ucPeerRSvValue); //save the new value
             } else if (ucPeerRSvIndex == 2) { //new high_address
                 if (ucPeerRSvValue != 0x7F) {
                     //initMessagesArray();
                     ucBoardAddrHi = ucPeerRSvValue;
-                    sv.writeSVStorage(SV_ADDR_NODE_ID_H, ucPeerRSvValue); //save the new value
+                    svWrite(SV_ADDR_NODE_ID_H, ucPeerRSvValue); //save the new value
                 }
                 cOutBuf->data[0x0B] = 0x7F;
                 cOutBuf->data[0x0E] = 0x7F;
-            } else if (ucPeerRSvIndex < (TOTAL_NR_OF_PORTS * 3 + 3)) { //nr_of_ports (1) * 3 register starting with the address 3
-                sv.writeSVStorage(SV_ADDR_USER_BASE + ucPeerRSvIndex, ucPeerRSvValue); //save the new value
-                if ((ucPeerRSvIndex % 3) == 0) { // port type. If output, increase the total number of outputs
-                   if(ucPeerRSvValue == 0x10){
-                      bUpdateOutputs = true; //activate the outputs structure update 
-                      outputs[outsNr].idx = ucPeerRSvIndex;
-                      outsNr++;
-                   }
-                }
+            } else if ((ucPeerRSvIndex >= SV_STAT_BASE) && (ucPeerRSvIndex < SV_STAT_BASE + SV_STAT_LEN)) { //runtime counters: read only, a write clears them
+                statsReset();
+                cOutBuf->data[0x0B] = ucBoardAddrHi;
+                cOutBuf->data[0x0E] = 0;
+            } else if ((ucPeerRSvIndex < SV_PORTS_END) || 
+                       ((ucPeerRSvIndex >= SV_CFG_BASE) && (ucPeerRSvIndex < SV_CFG_END))) { //nr_of_ports (1) * 3 register starting with the address 3 + board configuration
+                svWrite(SV_ADDR_USER_BASE + ucPeerRSvIndex, ucPeerRSvValue); //save the new value; the outputs are rebuilt by svApplyChanges()
                 cOutBuf->data[0x0B] = ucBoardAddrHi; 
-                ucTempData = sv.readSVStorage(SV_ADDR_USER_BASE + ucPeerRSvIndex);
+                ucTempData = svRead(SV_ADDR_USER_BASE + ucPeerRSvIndex);
                 if (ucTempData & 0x80) { //msb==1 => sent in PXCTL2
                    cOutBuf->data[0x0A] |= 0x08; //PXCTL2.3 = D8.7
                 }
@@ -139,18 +143,18 @@ uint8_t processXferMess(lnMsg *LnRecMsg, lnMsg *cOutBuf){
         if ((ucPeerRCommand == SV_CMD_READ) || (ucPeerRCommand == 0)) { //read command. Answer to sender
             cOutBuf->data[0x0B] = 0x01;
 
-            ucTempData = sv.readSVStorage(SV_ADDR_USER_BASE + ucPeerRSvIndex);
+            ucTempData = svRead(SV_ADDR_USER_BASE + ucPeerRSvIndex);
             if (ucTempData & 0x80) { //msb==1 => sent in PXCTL2
                 cOutBuf->data[0x0A] |= 0x02; //PXCTL2.1 = D6.7
             }
             cOutBuf->data[0x0C] = ucTempData & 0x7F;
 
-            ucTempData = sv.readSVStorage(SV_ADDR_USER_BASE + ucPeerRSvIndex + 1);
+            ucTempData = svRead(SV_ADDR_USER_BASE + ucPeerRSvIndex + 1);
             if (ucTempData & 0x80) { //msb==1 => sent in PXCTL2
                 cOutBuf->data[0x0A] |= 0x04; //PXCTL2.2 = D7.7
             }
             cOutBuf->data[0x0D] = ucTempData & 0x7F;
-            ucTempData = sv.readSVStorage(SV_ADDR_USER_BASE + ucPeerRSvIndex + 2);
+            ucTempData = svRead(SV_ADDR_USER_BASE + ucPeerRSvIndex + 2);
             if (ucTempData & 0x80) { //msb==1 => sent in PXCTL2
                 cOutBuf->data[0x0A] |= 0x08; //PXCTL2.3 = D8.7
             }
@@ -172,6 +176,273 @@ uint8_t processXferMess(lnMsg *LnRecMsg, lnMsg *cOutBuf){
     return 1;  //should put the right here
 }
 
+/*
+ * LNSV2 message: E5 10 <SRC> <SV_CMD> <SV_TYPE = 2> <SVX1> <DST_L> <DST_H> <SV_ADRL> <SV_ADRH>
+ *                <SVX2> <D1> <D2> <D3> <D4> <CHK>
+ * SVX1 / SVX2 (the PXCT1 / PXCT2 of the LocoIO messages) = 0x10 | MSBs of the next 4 bytes
+ */
+boolean isSv2Message(lnMsg *LnRecMsg){
+    return ((LnRecMsg->data[0x00] == OPC_PEER_XFER) && (LnRecMsg->data[0x04] == SV_TYPE_LNSV2) &&
+            ((LnRecMsg->data[0x05] & 0xF0) == 0x10) && ((LnRecMsg->data[0x0A] & 0xF0) == 0x10));
+}
+
+/*
+ * Move the MSBs from the SVX byte in the 4 following bytes (decode) or back (encode)
+ */
+static void sv2DecodeMsbs(uint8_t *pData){
+    for (uint8_t i = 0; i < 4; i++) {
+        if (pData[0] & (1 << i)) {
+            pData[i + 1] |= 0x80;
+        }
+    }
+}
+
+static void sv2EncodeMsbs(uint8_t *pData){
+    pData[0] = 0x10;
+    for (uint8_t i = 0; i < 4; i++) {
+        if (pData[i + 1] & 0x80) {
+            pData[0] |= 1 << i;
+            pData[i + 1] &= 0x7F;
+        }
+    }
+}
+
+/*
+ * Put the board identity in a LNSV2 reply: DST = board address, SV_ADRL/H = manufacturer /
+ * developer id, D1/D2 = product id, D3/D4 = serial number
+ */
+static void sv2SetIdentity(uint8_t *pOut){
+    pOut[0x06] = ucBoardAddrLo;
+    pOut[0x07] = ucBoardAddrHi;
+    pOut[0x08] = MANUF_ID;
+    pOut[0x09] = BOARD_TYPE;
+    pOut[0x0B] = PRODUCT_ID & 0xFF;
+    pOut[0x0C] = PRODUCT_ID >> 8;
+    pOut[0x0D] = svRead(SV_ADDR_SERIAL_NUMBER_L);
+    pOut[0x0E] = svRead(SV_ADDR_SERIAL_NUMBER_H);
+}
+
+/*
+ * Finish a LNSV2 reply: reply flag, MSBs in SVX1 / SVX2, check summ
+ */
+static void sv2FinishReply(uint8_t *pOut, uint8_t ucCmd){
+    pOut[0x03] = ucCmd | 0x40; //reply
+    sv2EncodeMsbs(&pOut[0x05]);
+    sv2EncodeMsbs(&pOut[0x0A]);
+    pOut[0x0F] = lnCalcCheckSumm(pOut, LN_MESS_LEN_PEER);
+}
+
+#if UID_TABLE
+static uint8_t ucStagedUid[4]; //UID bytes 0..3 of the next UID table SET / DELETE
+#endif
+
+/*
+ * Process the LNSV2 commands: single, masked and 4 bytes write / read of the SVs addressed
+ * to this board (through the RAM mirror), discover, identify, change address and reconfigure,
+ * and the UID table commands.
+ * Return 1 if the reply in cOutBuf should be sent now. The discover reply is deferred to a
+ * random slot and sent by sv2DeferredProcessing()
+ */
+uint8_t processSv2Mess(lnMsg *LnRecMsg, lnMsg *cOutBuf){
+    uint8_t  *pOut = cOutBuf->data;
+    uint8_t  ucCmd = LnRecMsg->data[0x03];
+    uint16_t uiDst;
+    uint16_t uiSvAdr;
+    uint8_t  ucNrOfSv = 1;
+
+    memcpy(pOut, LnRecMsg->data, LN_MESS_LEN_PEER); //the reply is the received message with the new data
+    sv2DecodeMsbs(&pOut[0x05]);
+    sv2DecodeMsbs(&pOut[0x0A]);
+
+    uiDst = pOut[0x06] | (pOut[0x07] << 8);
+    uiSvAdr = pOut[0x08] | (pOut[0x09] << 8);
+
+    if (ucCmd == SV_CMD_DISCOVER) { //broadcast; all the boards answer, each one in its slot
+        sv2SetIdentity(pOut);
+        sv2FinishReply(pOut, ucCmd);
+        memcpy(DeferredPacket.data, pOut, LN_MESS_LEN_PEER);
+        ulDeferredTime = millis() + random(DISCOVER_SLOTS) * DISCOVER_SLOT_MS;
+        deferredProcessingNeeded = true;
+        return 0;
+    }
+
+    if (ucCmd == SV_CMD_CHANGE_ADDR) { //addressed by the identity from the discover / identify reply
+        if ((pOut[0x08] != MANUF_ID) || (pOut[0x09] != BOARD_TYPE) ||
+            ((pOut[0x0B] | (pOut[0x0C] << 8)) != PRODUCT_ID) ||
+            (pOut[0x0D] != svRead(SV_ADDR_SERIAL_NUMBER_L)) || (pOut[0x0E] != svRead(SV_ADDR_SERIAL_NUMBER_H))) {
+            return 0;
+        }
+        if (((uiDst >> 8) != 1) || ((uiDst & 0xFF) == 0) || ((uiDst & 0xFF) > 0x7F)) { //not a LocoIO address (high 1, low 1..127): rejected
+            return 0;
+        }
+        svWrite(SV_ADDR_NODE_ID_L, uiDst & 0xFF);
+        svWrite(SV_ADDR_NODE_ID_H, uiDst >> 8);
+        ucBoardAddrLo = uiDst & 0xFF;
+        ucBoardAddrHi = uiDst >> 8;
+        sv2SetIdentity(pOut);
+        sv2FinishReply(pOut, ucCmd);
+        return 1;
+    }
+
+    if (uiDst != (ucBoardAddrLo | (ucBoardAddrHi << 8))) { //not for me
+        return 0;
+    }
+
+    if ((ucCmd == SV_CMD_WRITE4) || (ucCmd == SV_CMD_READ4)) {
+        ucNrOfSv = 4;
+    }
+
+    switch (ucCmd) {
+        case SV_CMD_IDENTIFY:
+            sv2SetIdentity(pOut);
+            sv2FinishReply(pOut, ucCmd);
+            return 1;
+
+        case SV_CMD_RECONFIGURE: //the reply is sent first, the new configuration is applied by the caller
+            sv2FinishReply(pOut, ucCmd);
+            return 1;
+
+        case SV_CMD_WRITE:
+        case SV_CMD_WRITE4:
+            if ((uiSvAdr >= SV_ADDR_USER_BASE + SV_STAT_BASE) && (uiSvAdr < SV_ADDR_USER_BASE + SV_STAT_BASE + SV_STAT_LEN)) {
+                statsReset();
+                break;
+            }
+            if ((uiSvAdr < SV_ADDR_NODE_ID_L) || (uiSvAdr + ucNrOfSv > SV_MIRROR_LEN)) {
+                return 0;
+            }
+            for (uint8_t i = 0; i < ucNrOfSv; i++) {
+                svWrite(uiSvAdr + i, pOut[0x0B + i]);
+            }
+            break;
+
+        case SV_CMD_MASKED_WRITE: //D1 = value, D2 = mask
+            if ((uiSvAdr < SV_ADDR_NODE_ID_L) || (uiSvAdr >= SV_MIRROR_LEN)) {
+                return 0;
+            }
+            svWrite(uiSvAdr, (svRead(uiSvAdr) & ~pOut[0x0C]) | (pOut[0x0B] & pOut[0x0C]));
+            break;
+
+#if UID_TABLE
+        case SV_CMD_UIDTAB_STAGE:
+            memcpy(ucStagedUid, &pOut[0x0B], 4);
+            sv2FinishReply(pOut, ucCmd);
+            return 1;
+
+        case SV_CMD_UIDTAB_SET:
+        case SV_CMD_UIDTAB_DELETE:
+        case SV_CMD_UIDTAB_CLEAR:
+        {
+            uint8_t ucUid[UID_LEN];
+            boolean bDone = true;
+            memcpy(ucUid, ucStagedUid, 4);
+            memcpy(&ucUid[4], &pOut[0x0B], UID_LEN - 4);
+            if (ucCmd == SV_CMD_UIDTAB_SET) {
+                bDone = uidTabSet(ucUid, uiSvAdr);
+            } else if (ucCmd == SV_CMD_UIDTAB_DELETE) {
+                bDone = uidTabDelete(ucUid);
+            } else {
+                uidTabClear();
+            }
+            pOut[0x0B] = bDone ? 1 : 0;
+            pOut[0x0C] = 0;
+            pOut[0x0D] = 0;
+            pOut[0x0E] = uidTabCnt;
+            sv2FinishReply(pOut, ucCmd);
+            return 1;
+        }
+
+        case SV_CMD_UIDTAB_READ:
+        {
+            uint8_t ucUid[UID_LEN];
+            uint16_t uiLoco = 0;
+            memset(ucUid, 0, sizeof(ucUid));
+            if (uiSvAdr < uidTabCnt) {
+                uiLoco = uidTabRead(uiSvAdr, ucUid);
+            }
+            if (pOut[0x0B] == 0) {
+                memcpy(&pOut[0x0B], ucUid, 4);
+            } else {
+                memcpy(&pOut[0x0B], &ucUid[4], UID_LEN - 4);
+                pOut[0x0E] = uidTabCnt;
+            }
+            pOut[0x08] = uiLoco & 0xFF;
+            pOut[0x09] = uiLoco >> 8;
+            sv2FinishReply(pOut, ucCmd);
+            return 1;
+        }
+#endif
+
+        case SV_CMD_READ:
+        case SV_CMD_READ4:
+            if ((uiSvAdr == 0) || (uiSvAdr + ucNrOfSv - 1 > SV_MAX_READ)) {
+                return 0;
+            }
+            break;
+
+        default:
+            return 0;
+    }
+
+    /* a write of the board address is active immediately; the reply goes out with the new address*/
+    ucBoardAddrLo = svRead(SV_ADDR_NODE_ID_L);
+    ucBoardAddrHi = svRead(SV_ADDR_NODE_ID_H);
+
+    /* the reply carries the (new) SV values in D1..D4*/
+    for (uint8_t i = 0; i < 4; i++) {
+        pOut[0x0B + i] = (i < ucNrOfSv) ? svRead(uiSvAdr + i) : 0;
+    }
+
+    sv2FinishReply(pOut, ucCmd);
+
+    return 1;
+}
+
+/*
+ * Queue the deferred LNSV2 discover reply once its slot is reached. Called from loop()
+ * while deferredProcessingNeeded is set
+ */
+void sv2DeferredProcessing(void){
+    if ((int32_t)(millis() - ulDeferredTime) < 0) {
+        return;
+    }
+    lnMsg *pOut = lnTxSvAlloc();
+    if (pOut != NULL) {
+        memcpy(pOut->data, DeferredPacket.data, LN_MESS_LEN_PEER);
+        lnTxSvCommit();
+        deferredProcessingNeeded = false;
+    }
+}
+
+/*
+ * Apply the SV configuration without a reset: board address, sensor addresses and
+ * UID message headers of all the readers
+ */
+void boardReconfigure(void){
+    ucBoardAddrLo = svRead(SV_ADDR_NODE_ID_L);
+    ucBoardAddrHi = svRead(SV_ADDR_NODE_ID_H);
+    uiPortsChanged = (1 << NR_OF_RFID_PORTS) - 1;
+    bUpdateOutputs = true;
+    svApplyChanges();
+}
+
+/*
+ * Generate a serial number for the LNSV2 identification. There is no unique id in the
+ * AVR, so the noise of the analog inputs and the startup timing are mixed.
+ * Called only when the board gets its first configuration
+ */
+uint16_t genSerialNumber(void){
+    uint16_t uiSerial = micros();
+
+    for (uint8_t i = 0; i < 32; i++) {
+        uiSerial = (uiSerial << 3) ^ (uiSerial >> 13) ^ analogRead(A0 + (i & 0x03)) ^ micros();
+    }
+    if ((uiSerial == LEGACY_SERIAL) || (uiSerial == 0xFFFF) || (uiSerial == 0)) {
+        uiSerial ^= 0x1234;
+    }
+    return uiSerial;
+}
+
 /**********char lnCalcCheckSumm(...)**********************
  *
  *
@@ -221,18 +492,38 @@ void boardSetup(void){
        sv.writeSVStorage(SV_ADDR_NODE_ID_H, ucBoardAddrHi );
        sv.writeSVStorage(SV_ADDR_NODE_ID_L, ucBoardAddrLo);
   
-       sv.writeSVStorage(SV_ADDR_SERIAL_NUMBER_H, 0x56);
-       sv.writeSVStorage(SV_ADDR_SERIAL_NUMBER_L, 0x78);
+       uint16_t uiSerial = genSerialNumber();
+       sv.writeSVStorage(SV_ADDR_SERIAL_NUMBER_H, uiSerial >> 8);
+       sv.writeSVStorage(SV_ADDR_SERIAL_NUMBER_L, uiSerial & 0xFF);
+
+       sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_DEBOUNCE, PRES_DEBOUNCE_DEF);
+       sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_HOLDOFF, PRES_HOLDOFF_DEF);
+       sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_PRIO, LN_PRIO_LEGACY);
+       sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_PRIO_LVL, LN_PRIO_LVL_DEF);
+       sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_HEALTH, HEALTH_PERIOD_DEF);
+       for (uint8_t i = 0; i < 4 * SPEED_PAIRS; i++) {
+          sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_PAIR + i, 0); //no reader pair
+       }
+       for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+          sv.writeSVStorage(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + i, 0xFF); //all the readers probed at the next boot
+       }
 
        int iSenAddr = 0;
        for(int i=0; i<NR_OF_RFID_PORTS; i++){
-          ucSenType[i]=0x0F;
+          rfidPorts[i].senType=0x0F;
           iSenAddr = SV_ADDR_USER_BASE + 3 + 3*i;         
-          sv.writeSVStorage(iSenAddr+2, i*0x20); //1 for port1, 2 for port 2
-          sv.writeSVStorage(iSenAddr+1, 0);
-          sv.writeSVStorage(iSenAddr, ucSenType[i]);
+          sv.writeSVStorage(iSenAddr+2, (i & 0x01) << 5); //sensor address i+1: 1 for port1, 2 for port 2...
+          sv.writeSVStorage(iSenAddr+1, i >> 1);
+          sv.writeSVStorage(iSenAddr, rfidPorts[i].senType);
        }
     } else { //right content in the memory
+       uint16_t uiSerial = sv.readSVStorage(SV_ADDR_SERIAL_NUMBER_L) | (sv.readSVStorage(SV_ADDR_SERIAL_NUMBER_H) << 8);
+       if ((uiSerial == LEGACY_SERIAL) || (uiSerial == 0xFFFF) || (uiSerial == 0)) { //all the old boards have the same serial
+          uiSerial = genSerialNumber();
+          sv.writeSVStorage(SV_ADDR_SERIAL_NUMBER_H, uiSerial >> 8);
+          sv.writeSVStorage(SV_ADDR_SERIAL_NUMBER_L, uiSerial & 0xFF);
+       }
+
        if(bSerialOk) { //serial interface ok
           for(uint8_t i = 0; i<verLen; i++){
              Serial.print((char)boardVer[i]);
@@ -262,120 +553,1962 @@ void calcSenAddr(uint8_t port){
     uint8_t iSenAddr = 0;
     
        iSenAddr = SV_ADDR_USER_BASE + 3 + 3*port;         
-       uiAddrSenFull[port] = 256 * (sv.readSVStorage(iSenAddr+2) & 0x0F) + 2 * sv.readSVStorage(iSenAddr+1) +
-                    (sv.readSVStorage(iSenAddr+2) >> 5) + 1;
+       rfidPorts[port].addrSenFull = 256 * (svRead(iSenAddr+2) & 0x0F) + 2 * svRead(iSenAddr+1) +
+                    (svRead(iSenAddr+2) >> 5) + 1;
 
-       ucAddrHiSen[port] = (uiAddrSenFull[port] >> 7) & 0x7F;
-       ucAddrLoSen[port] = uiAddrSenFull[port] & 0x7F;        
-       ucSenType[port] = sv.readSVStorage(iSenAddr); //"sensor" type = in
-       setMessageHeader(port, port);
+       rfidPorts[port].addrHiSen = (rfidPorts[port].addrSenFull >> 7) & 0x7F;
+       rfidPorts[port].addrLoSen = rfidPorts[port].addrSenFull & 0x7F;        
+       rfidPorts[port].senType = svRead(iSenAddr); //"sensor" type = in
+       setMessageHeader(port);
 }
 
 void printSensorData(uint8_t port){
        Serial.print(F("Full sensor addr: "));
-       Serial.println(uiAddrSenFull[port]);
+       Serial.println(rfidPorts[port].addrSenFull);
        Serial.print(F("Sensor AddrH: "));
-       Serial.print(ucAddrHiSen[port]);
+       Serial.print(rfidPorts[port].addrHiSen);
        Serial.print(F(" Sensor AddrL: "));
-       Serial.print(ucAddrLoSen[port]);
+       Serial.print(rfidPorts[port].addrLoSen);
        Serial.println();  
 }
 
+#if DBG_LOG
+/* SV request answered: only the SV command and the SV index are logged*/
+static void dbgLogSv(uint8_t ucCmd, uint16_t uiSvIdx){
+   const uint8_t ucEv[DBG_SV_LEN] = {ucCmd, (uint8_t)(uiSvIdx & 0xFF), (uint8_t)(uiSvIdx >> 8)};
+
+   dbgLog(DBG_EV_SV, LN_NO_PORT, ucEv, DBG_SV_LEN);
+}
+#else
+  #define dbgLogSv(ucCmd, uiSvIdx)
+#endif
+
 /*
  * The function to decode the received ln message
  */
 void lnDecodeMessage(lnMsg *LnPacket)
 {
     uint8_t msgLen = getLnMsgSize(LnPacket);
-     
-    //Change the board & sensor addresses. 
-    if(msgLen == 0x10){  //XFERmessage, check if it is for me. Used to change the addresses
-      if((LnPacket->data[3] == ucBoardAddrLo) || (LnPacket->data[3] == 0)){ //my low address or query
-        if((LnPacket->data[4] == ucBoardAddrHi) || (LnPacket->data[4] == 0x7F)){ ////my high address or query
-           //svStatus = sv.processMessage(LnPacket);
-         
-           processXferMess(LnPacket, &SendPacket);
-        
-           /*5 sec timeout.*/
-           LN_STATUS lnSent = LocoNet.send( &SendPacket, LN_BACKOFF_MAX - (ucBoardAddrLo % 10) );   //trying to differentiate the ln answer time   
-        
-          // Rocrail compatible addressing
-          for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
-            calcSenAddr(i);
+    lnMsg *pOut;
 
-#ifdef _SER_DEBUG
-            if (bSerialOk) {
-              printSensorData(i);
+    switch (LnPacket->data[0]) {
+      case OPC_SW_REQ:
+        if (isSenQuery(LnPacket)) {
+          if (uiSenQueryPort == LN_NO_PORT) { //a repeated query doesn't restart the running report
+            ulSenQueryTime = millis() + random(SEN_QUERY_SLOTS) * SEN_QUERY_SLOT_MS;
+            uiSenQueryPort = 0;
+          }
+        } else if (outsNr != 0) {
+          outputsSwMessage(LnPacket);
+        }
+        break;
+
+      case OPC_SW_STATE:
+        if (outsNr != 0) {
+          outputsSwMessage(LnPacket);
+        }
+        break;
+
+      case OPC_PEER_XFER:
+        if (msgLen != 0x10) {
+          break;
+        }
+        //Change the board & sensor addresses. 
+        if (isSv2Message(LnPacket)) { //LNSV2 message
+          pOut = lnTxSvAlloc();
+          if ((pOut != NULL) && processSv2Mess(LnPacket, pOut)) {
+            lnTxSvCommit(); //the reply is built with the old configuration
+            dbgLogSv(LnPacket->data[3], (LnPacket->data[8] | ((LnPacket->data[5] & 0x04) << 5)) |
+                                        ((LnPacket->data[9] | ((LnPacket->data[5] & 0x08) << 4)) << 8));
+            if (LnPacket->data[3] == SV_CMD_RECONFIGURE) {
+              boardReconfigure();
+            } else {
+              svApplyChanges();
             }
-#endif
-	  }//for(uint8_t i
-        } //if(LnPacket->data[4]               
-      } //if(LnPacket->data[3]
-    } //if(msgLen == 0x10)
+          }
+        } else if ((LnPacket->data[3] == ucBoardAddrLo) || (LnPacket->data[3] == 0)) { //XFER message: my low address or query
+          if ((LnPacket->data[4] == ucBoardAddrHi) || (LnPacket->data[4] == 0x7F)) { //my high address or query
+            //svStatus = sv.processMessage(LnPacket);
+            pOut = lnTxSvAlloc();
+            if (pOut == NULL) { //no room for the reply; the request is repeated by the programming tool
+              break;
+            }
+
+            processXferMess(LnPacket, pOut);
+            lnTxSvCommit(); //sent by lnTxProcess()
+            dbgLogSv(LnPacket->data[6], LnPacket->data[7]); //MSBs decoded by processXferMess()
+
+            // Rocrail compatible addressing; only the ports with changed SVs
+            svApplyChanges();
+          } //if(LnPacket->data[4]
+        } //if(LnPacket->data[3]
+        break;
+
+      default: //not for this board
+        break;
+    }
 }
 
 #if USE_INTERRUPTS
 /*
- * MFRC522 interrupt serving routines
+ * MFRC522 interrupt serving routine, one instance per reader. Only the flag is set; 
+ * the tag is read in loop(). Only the first IRQ after the rearm is the tag answer to the
+ * REQA; the IRQs of the UID reading that follows don't move its time stamp
+ */
+template <uint8_t port> void readCardIsr(void){
+   if (!rfidPorts[port].bNewInt) {
+      rfidPorts[port].intTime = micros(); //time stamp of the tag answer, free of the loop() delay
+   }
+   rfidPorts[port].bNewInt = true;
+}
+
+/*
+ * Attach readCardIsr<port> to the pin. The port -> ISR selection is unrolled at compile
+ * time, so no ISR table is kept in RAM
  */
-void readCard1(uint8_t){
-   bNewInt[0] = true;
+template <uint8_t N> void attachIsr(uint8_t port, uint8_t pin){
+   if (port == N - 1) {
+      attachInterrupt(digitalPinToInterrupt(pin), readCardIsr<N - 1>, FALLING);
+   } else {
+      attachIsr<N - 1>(port, pin);
+   }
+}
+
+template <> void attachIsr<0>(uint8_t port, uint8_t pin){
 }
 
-void readCard2(uint8_t){
-   bNewInt[1] = true;
+void attachReaderIsr(uint8_t port, uint8_t pin){
+   attachIsr<NR_OF_RFID_PORTS>(port, pin);
 }
 /*
- * The function sending to the MFRC522 the needed commands to activate the reception
+ * The function sending to the MFRC522 the needed commands to activate the reception:
+ * a REQA is sent and the receiver waits for the answer of a tag (RxIrq)
  */
-void activateRec(MFRC522 mfrc522){
-    mfrc522.PCD_WriteRegister(mfrc522.FIFODataReg,mfrc522.PICC_CMD_REQA);
-    mfrc522.PCD_WriteRegister(mfrc522.CommandReg,mfrc522.PCD_Transceive);  
-    mfrc522.PCD_WriteRegister(mfrc522.BitFramingReg, 0x87);    
+void rearmReader(uint8_t port){
+    rfidPorts[port].bNewInt = false; //the IRQs of the synchronous reader accesses are ignored
+    activateRec(port); //rearm the reading part of the mfrc522
+    rfidPorts[port].rearmTime = millis();
 }
 
 /*
- * The function to clear the pending interrupt bits after interrupt serving routine
+ * Clear the pending interrupt bits (releases the IRQ pin), flush the FIFO and start the REQA;
+ * all in one SPI transaction
  */
-void clearInt(MFRC522 mfrc522){
-   mfrc522.PCD_WriteRegister(mfrc522.ComIrqReg,0x7F);
+void activateRec(uint8_t port){
+    const uint8_t regVals[] = {
+        MFRC522::CommandReg,    MFRC522::PCD_Idle,
+        MFRC522::ComIrqReg,     0x7F,
+        MFRC522::FIFOLevelReg,  0x80,
+        MFRC522::FIFODataReg,   MFRC522::PICC_CMD_REQA,
+        MFRC522::CommandReg,    MFRC522::PCD_Transceive,
+        MFRC522::BitFramingReg, 0x87};   //7 bits, StartSend
+    rfidWriteRegs(port, regVals, sizeof(regVals) / 2);
 }
 #endif
 
-void buildLnMessage(MFRC522 mfrc522, uint8_t uiRfidPort, uint8_t uiBufWrIdx){
-   setMessageHeader(uiRfidPort, uiBufWrIdx); //if the sensor address was changed, update the header
+/**
+ * Build the UID message of the port directly in the send slot: the prebuilt header is
+ * copied and the UID bytes are split in 7 bit LSBs + the MSBs byte. The check summ starts
+ * from the cached header check summ
+ */
+void buildLnMessage(const MFRC522::Uid &uid, uint8_t port, lnMsg *pMsg){
+   uint8_t *pData = pMsg->data;
+   uint8_t ucChk = rfidPorts[port].lnHdrChk;
+   uint8_t ucMsbs = 0;
 
-   /****
-   * Put the new data in buffer
-   */
-   SendPacketSensor[uiBufWrIdx].data[uiLnSendCheckSumIdx] = uiStartChkSen; //start with header check summ
-   SendPacketSensor[uiBufWrIdx].data[uiLnSendMsbIdx] = 0; //clear the byte for the ms bits
-   for (uint8_t i = 0, j = 5; i < UID_LEN; i++, j++) {
-      if (mfrc522.uid.size > i) {
-        SendPacketSensor[uiBufWrIdx].data[j] = mfrc522.uid.uidByte[i] & 0x7F; //loconet bytes have only 7 bits;
-        // MSbit is transmited in the SendPacket.data[10]
-        if(mfrc522.uid.uidByte[i] & 0x80) {
-           SendPacketSensor[uiBufWrIdx].data[uiLnSendMsbIdx] |= 1 << i;
-        }
-        SendPacketSensor[uiBufWrIdx].data[uiLnSendCheckSumIdx] ^= SendPacketSensor[uiBufWrIdx].data[j]; //calculate the checksumm
-      } else { //if (mfrc522[port].uid.
-        SendPacketSensor[uiBufWrIdx].data[j] = 0;
+   memcpy(pData, rfidPorts[port].lnHdr, LN_UID_HDR_LEN);
+
+   for (uint8_t i = 0; i < UID_LEN; i++) {
+      uint8_t ucUidByte = (i < uid.size) ? uid.uidByte[i] : 0;
+      pData[LN_UID_HDR_LEN + i] = ucUidByte & 0x7F; //loconet bytes have only 7 bits;
+      ucChk ^= ucUidByte & 0x7F;
+      ucMsbs |= (ucUidByte >> 7) << i; //MSbit is transmited in the UID_MSBS byte
+   }
+
+   pData[uiLnSendMsbIdx] = ucMsbs;
+   pData[uiLnSendCheckSumIdx] = ucChk ^ ucMsbs;
+}
+
+
+#if UID_TABLE
+static __uidIdxType uidIdx[UIDTAB_MAX]; //sorted by hash
+uint8_t uidTabCnt = 0;
+
+static uint16_t uidHash(const uint8_t *pUid){
+   uint16_t uiHash = 0;
+
+   for (uint8_t i = 0; i < UID_LEN; i++) {
+      uiHash = (uiHash << 5) + (uiHash >> 11) + pUid[i];
+   }
+   return uiHash;
+}
+
+static uint16_t uidTabEeAddr(uint8_t slot){
+   return UIDTAB_EE_BASE + 1 + slot * UIDTAB_ENTRY_LEN;
+}
+
+/*
+ * The EEPROM writes of the table wait in uidWq[] and are done by uidTabFlush() when loop() is idle,
+ * so a SET / DELETE received from the bus doesn't block for ~3.3 ms per written byte.
+ * The queue keeps the order of the writes: the number of entries is written after the entry itself
+ */
+static __uidEeWriteType uidWq[UIDTAB_WQ_LEN];
+static uint8_t uidWqRd = 0;
+static uint8_t uidWqCnt = 0;
+
+/* EEPROM byte of the table, as it will be once the queued writes are done*/
+static uint8_t uidTabEeRead(uint16_t addr){
+   for (uint8_t i = uidWqCnt; i > 0; i--) { //the newest write first
+      __uidEeWriteType *pWr = &uidWq[(uidWqRd + i - 1) % UIDTAB_WQ_LEN];
+      if (pWr->addr == addr) {
+         return pWr->value;
       }
-   } //for(i=0
+   }
+   return EEPROM.read(addr);
+}
 
-   SendPacketSensor[uiBufWrIdx].data[uiLnSendCheckSumIdx] ^= SendPacketSensor[uiBufWrIdx].data[uiLnSendMsbIdx]; //calculate the checksumm
+/* queue the EEPROM write, only if the value is changed. Queue full => the oldest write is done now*/
+static void uidTabEeWrite(uint16_t addr, uint8_t value){
+   if (uidTabEeRead(addr) == value) {
+      return;
+   }
+   if (uidWqCnt == UIDTAB_WQ_LEN) {
+      uidTabFlush();
+   }
+   __uidEeWriteType *pWr = &uidWq[(uidWqRd + uidWqCnt) % UIDTAB_WQ_LEN];
+   pWr->addr = addr;
+   pWr->value = value;
+   uidWqCnt++;
 }
 
+/*
+ * Do the oldest queued EEPROM write of the table. One EEPROM write per call, like svFlush().
+ * Return true if a write was done
+ */
+boolean uidTabFlush(void){
+   while (uidWqCnt > 0) {
+      __uidEeWriteType *pWr = &uidWq[uidWqRd];
+      uidWqRd = (uidWqRd + 1) % UIDTAB_WQ_LEN;
+      uidWqCnt--;
+      if (EEPROM.read(pWr->addr) != pWr->value) { //a later write may have set it back
+         EEPROM.write(pWr->addr, pWr->value);
+         stats.eeWrites++;
+         return true;
+      }
+   }
+   return false;
+}
 
-void varInit(void){
-   for(uint8_t i = 0; i < NR_OF_RFID_PORTS; i++){
-     for(uint8_t j = 0; j < UID_LEN; j++){
-       oldUid[i][j] = 0;
-     }
-     uiNrEmptyReads[i] = 3;
-#if USE_INTERRUPTS
-     bNewInt[i] = false;
+/* first index position with a hash >= uiHash*/
+static uint8_t uidIdxLowerBound(uint16_t uiHash){
+   uint8_t lo = 0;
+   uint8_t hi = uidTabCnt;
+
+   while (lo < hi) {
+      uint8_t mid = (lo + hi) / 2;
+      if (uidIdx[mid].hash < uiHash) {
+         lo = mid + 1;
+      } else {
+         hi = mid;
+      }
+   }
+   return lo;
+}
+
+static void uidIdxInsert(uint16_t uiHash, uint8_t slot){
+   uint8_t pos = uidIdxLowerBound(uiHash);
+
+   memmove(&uidIdx[pos + 1], &uidIdx[pos], (uidTabCnt - pos) * sizeof(uidIdx[0]));
+   uidIdx[pos].hash = uiHash;
+   uidIdx[pos].slot = slot;
+   uidTabCnt++;
+}
+
+/* index position of the UID; 0xFF if not in the table*/
+static uint8_t uidIdxFind(const uint8_t *pUid){
+   uint16_t uiHash = uidHash(pUid);
+
+   for (uint8_t pos = uidIdxLowerBound(uiHash); (pos < uidTabCnt) && (uidIdx[pos].hash == uiHash); pos++) {
+      uint16_t addr = uidTabEeAddr(uidIdx[pos].slot);
+      uint8_t i;
+      for (i = 0; i < UID_LEN; i++) {
+         if (uidTabEeRead(addr + i) != pUid[i]) {
+            break;
+         }
+      }
+      if (i == UID_LEN) {
+         return pos;
+      }
+   }
+   return 0xFF;
+}
+
+/*
+ * Build the RAM index from the EEPROM table. Called once, at startup
+ */
+void uidTabInit(void){
+   uint8_t ucCnt = EEPROM.read(UIDTAB_EE_BASE);
+   uint8_t ucUid[UID_LEN];
+
+   if (ucCnt > UIDTAB_MAX) { //erased EEPROM
+      ucCnt = 0;
+      uidTabEeWrite(UIDTAB_EE_BASE, 0);
+   }
+
+   uidTabCnt = 0;
+   for (uint8_t slot = 0; slot < ucCnt; slot++) {
+      uidTabRead(slot, ucUid);
+      uidIdxInsert(uidHash(ucUid), slot);
+   }
+}
+
+/*
+ * Loco address of the (zero filled) UID; 0 if the UID is not in the table
+ */
+uint16_t uidTabLookup(const uint8_t *pUid){
+   uint8_t pos = uidIdxFind(pUid);
+
+   if (pos == 0xFF) {
+      return 0;
+   }
+   uint16_t addr = uidTabEeAddr(uidIdx[pos].slot) + UID_LEN;
+   return uidTabEeRead(addr) | (uidTabEeRead(addr + 1) << 8);
+}
+
+/*
+ * Add a UID or change its loco address. False if the table is full or the address is 0
+ */
+boolean uidTabSet(const uint8_t *pUid, uint16_t uiLoco){
+   uint8_t pos = uidIdxFind(pUid);
+   uint8_t slot;
+
+   if (uiLoco == 0) {
+      return false;
+   }
+   if (pos != 0xFF) {
+      slot = uidIdx[pos].slot;
+   } else {
+      if (uidTabCnt >= UIDTAB_MAX) {
+         return false;
+      }
+      slot = uidTabCnt;
+   }
+
+   uint16_t addr = uidTabEeAddr(slot);
+   for (uint8_t i = 0; i < UID_LEN; i++) {
+      uidTabEeWrite(addr + i, pUid[i]);
+   }
+   uidTabEeWrite(addr + UID_LEN, uiLoco & 0xFF);
+   uidTabEeWrite(addr + UID_LEN + 1, uiLoco >> 8);
+
+   if (pos == 0xFF) {
+      uidIdxInsert(uidHash(pUid), slot);
+      uidTabEeWrite(UIDTAB_EE_BASE, uidTabCnt);
+   }
+   return true;
+}
+
+/*
+ * Delete a UID: the last EEPROM entry is moved in its slot, so the entries stay contiguous
+ */
+boolean uidTabDelete(const uint8_t *pUid){
+   uint8_t pos = uidIdxFind(pUid);
+
+   if (pos == 0xFF) {
+      return false;
+   }
+
+   uint8_t slot = uidIdx[pos].slot;
+   uint8_t lastSlot = uidTabCnt - 1;
+
+   memmove(&uidIdx[pos], &uidIdx[pos + 1], (uidTabCnt - pos - 1) * sizeof(uidIdx[0]));
+   uidTabCnt--;
+
+   if (slot != lastSlot) {
+      uint16_t addrFrom = uidTabEeAddr(lastSlot);
+      uint16_t addrTo = uidTabEeAddr(slot);
+      for (uint8_t i = 0; i < UIDTAB_ENTRY_LEN; i++) {
+         uidTabEeWrite(addrTo + i, uidTabEeRead(addrFrom + i));
+      }
+      for (uint8_t i = 0; i < uidTabCnt; i++) {
+         if (uidIdx[i].slot == lastSlot) {
+            uidIdx[i].slot = slot;
+            break;
+         }
+      }
+   }
+   uidTabEeWrite(UIDTAB_EE_BASE, uidTabCnt);
+   return true;
+}
+
+void uidTabClear(void){
+   uidTabCnt = 0;
+   uidTabEeWrite(UIDTAB_EE_BASE, 0);
+}
+
+/*
+ * UID (in pUid) and loco address of the EEPROM slot
+ */
+uint16_t uidTabRead(uint8_t slot, uint8_t *pUid){
+   uint16_t addr = uidTabEeAddr(slot);
+
+   for (uint8_t i = 0; i < UID_LEN; i++) {
+      pUid[i] = uidTabEeRead(addr + i);
+   }
+   return uidTabEeRead(addr + UID_LEN) | (uidTabEeRead(addr + UID_LEN + 1) << 8);
+}
+
+/*
+ * Build the OPC_MULTI_SENSE transponding report of the port: D0 <0x20 present / 0x00 absent | zone hi>
+ * <zone lo> <loco hi; 0x7D = short address> <loco lo> <chk>. The zone is the sensor address of the port
+ */
+static void buildTranspMessage(uint8_t port, uint16_t uiLoco, boolean bPresent, lnMsg *pMsg){
+   uint16_t uiZone = rfidPorts[port].addrSenFull - 1;
+   uint8_t *pData = pMsg->data;
+
+   pData[0] = OPC_MULTI_SENSE;
+   pData[1] = ((uiZone >> 7) & 0x1F) | (bPresent ? 0x20 : 0x00);
+   pData[2] = uiZone & 0x7F;
+   if (uiLoco < 128) {
+      pData[3] = 0x7D;
+      pData[4] = uiLoco;
+   } else {
+      pData[3] = (uiLoco >> 7) & 0x7F;
+      pData[4] = uiLoco & 0x7F;
+   }
+   pData[5] = lnCalcCheckSumm(pData, 6);
+}
+
+/*
+ * Queue the transponding absent report of the port, if the reported tag is a known loco.
+ * Appended: it must not replace the sensor free message of the port, and a later message of
+ * the port must not replace the free message queued before it
+ */
+void queueTranspAbsent(uint8_t port){
+   if (rfidPorts[port].locoAddr == 0) {
+      return;
+   }
+   lnMsg *pTxMsg = lnRingAppend(port);
+   if (pTxMsg != NULL) {
+      buildTranspMessage(port, rfidPorts[port].locoAddr, false, pTxMsg);
+      lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = 0;
+      lnRingCommit();
+   }
+   rfidPorts[port].locoAddr = 0;
+}
 #endif
-   }  
+
+/*
+ * Queue the UID message of the tag just read by the reader of the port. With UID_TABLE, a tag found in
+ * the table is reported as its loco address (OPC_MULTI_SENSE, 6 bytes instead of 14)
+ */
+void queueTagReport(uint8_t port, uint32_t ulReadTime){
+   dbgLog(DBG_EV_TAG, port, mfrc522[port].uid.uidByte, mfrc522[port].uid.size);
+
+#if UID_TABLE
+   uint8_t ucUid[UID_LEN];
+   copyUid(mfrc522[port].uid.uidByte, ucUid, min(mfrc522[port].uid.size, UID_LEN));
+   rfidPorts[port].locoAddr = uidTabLookup(ucUid);
+#endif
+
+#if MULTI_TAG_MODE
+   lnMsg *pTxMsg = lnRingAppend(port); //each tag of the sweep has its own message
+#else
+   lnMsg *pTxMsg = lnRingAlloc(port);
+#endif
+   if (pTxMsg != NULL) {
+#if UID_TABLE
+      if (rfidPorts[port].locoAddr != 0) {
+         buildTranspMessage(port, rfidPorts[port].locoAddr, true, pTxMsg);
+      } else
+#endif
+      buildLnMessage(mfrc522[port].uid, port, pTxMsg); 
+      lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = ulReadTime;
+      lnRingCommit();
+   }
+   speedTagSeen(port, ulReadTime);
+}
+
+/*
+ * Queue the sensor message (0xB2) of the port => the RFID port can be used in Rocrail as a
+ * normal sensor
+ */
+static void buildSensorMessage(uint8_t port, boolean bOccupied, lnMsg *pTxMsg){
+   uint16_t uiAddr =  (rfidPorts[port].addrSenFull - 1) / 2;
+   pTxMsg->data[0] = 0xB2;
+   pTxMsg->data[1] = uiAddr & 0x7F; //ucAddrLoSen;
+   pTxMsg->data[2] = ((uiAddr >> 7) & 0x0F) | 0x40; //ucAddrHiSen & 0xEF;
+   if ((rfidPorts[port].addrSenFull & 0x01) == 0) {
+      pTxMsg->data[2] |= 0x20;
+   }
+   if (bOccupied) {
+      pTxMsg->data[2] |= 0x10;
+   }
+   pTxMsg->data[3] = lnCalcCheckSumm(pTxMsg->data, 4);
+}
+
+void queueSensorState(uint8_t port, boolean bOccupied){
+   lnMsg *pTxMsg = lnRingAlloc(port);
+   if (pTxMsg != NULL) {
+      buildSensorMessage(port, bOccupied, pTxMsg);
+      lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = 0;
+      lnRingCommit();
+   }
+}
+
+static __speedPairType speedPairs[SPEED_PAIRS];
+
+static void queueSpeedReport(uint8_t port, uint8_t ucDir, uint16_t uiSpeed){
+   lnMsg *pTxMsg = lnRingAppend(port);
+   if (pTxMsg != NULL) {
+      uint8_t *pData = pTxMsg->data;
+      pData[0] = 0xE4;
+      pData[1] = LN_SPEED_LEN;
+      pData[2] = LN_SPEED_TYPE;
+      pData[3] = rfidPorts[port].addrHiSen;
+      pData[4] = rfidPorts[port].addrLoSen;
+      pData[5] = ucDir;
+      pData[6] = (uiSpeed >> 7) & 0x7F;
+      pData[7] = uiSpeed & 0x7F;
+      pData[8] = lnCalcCheckSumm(pData, LN_SPEED_LEN);
+      lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = 0;
+      lnRingCommit();
+   }
+}
+
+/*
+ * A tag was reported by the reader of the port, read at ulReadTime (micros()). If the other
+ * reader of a pair saw the same tag before, the speed and direction of the passage are
+ * reported; otherwise the detection is remembered as the start of a passage. Each pair keeps
+ * one open passage per tag (SPEED_OPEN_MAX), so a train of tags between the readers is
+ * measured tag by tag; when the table is full the oldest passage is dropped
+ */
+void speedTagSeen(uint8_t port, uint32_t ulReadTime){
+   uint8_t ucUid[UID_LEN];
+
+   memset(ucUid, 0, UID_LEN);
+   copyUid(mfrc522[port].uid.uidByte, ucUid, min(mfrc522[port].uid.size, UID_LEN));
+
+   for (uint8_t k = 0; k < SPEED_PAIRS; k++) {
+      uint16_t uiCfg = SV_ADDR_USER_BASE + SV_CFG_PAIR + 4 * k;
+      uint8_t ucA = svRead(uiCfg) - 1;
+      uint8_t ucB = svRead(uiCfg + 1) - 1;
+      if ((ucA >= NR_OF_RFID_PORTS) || (ucB >= NR_OF_RFID_PORTS) || (ucA == ucB)) { //pair off
+         continue;
+      }
+      if ((port != ucA) && (port != ucB)) {
+         continue;
+      }
+
+      __speedOpenType *pFree = NULL;
+      __speedOpenType *pOldest = NULL;
+      uint32_t ulOldestDt = 0;
+      bool bDone = false;
+      for (uint8_t j = 0; j < SPEED_OPEN_MAX; j++) {
+         __speedOpenType *pOpen = &speedPairs[k].open[j];
+         uint32_t ulDt = ulReadTime - pOpen->time;
+         if ((pOpen->port != LN_NO_PORT) && (ulDt >= SPEED_TIMEOUT_US)) { //timed out
+            pOpen->port = LN_NO_PORT;
+         }
+         if (pOpen->port == LN_NO_PORT) {
+            if (pFree == NULL) {
+               pFree = pOpen;
+            }
+            continue;
+         }
+         if (!compareUid(ucUid, pOpen->uid, UID_LEN)) {
+            if (ulDt >= ulOldestDt) {
+               ulOldestDt = ulDt;
+               pOldest = pOpen;
+            }
+            continue;
+         }
+         if ((pOpen->port != port) && (ulDt >= 10)) { //end of the passage
+            uint16_t uiDist = svRead(uiCfg + 2) | (svRead(uiCfg + 3) << 8);
+            if ((uiDist != 0) && (uiDist <= SPEED_DIST_MAX)) {
+               uint32_t ulSpeed = ((uint32_t)uiDist * 100000UL) / (ulDt / 10); //mm/s
+               queueSpeedReport(ucA, (port == ucB) ? 0 : 1, (ulSpeed > 0x3FFF) ? 0x3FFF : ulSpeed);
+            }
+            pOpen->port = LN_NO_PORT;
+         } else { //seen again by the same reader: the passage starts again
+            pOpen->time = ulReadTime;
+            pOpen->port = port;
+         }
+         bDone = true;
+         break;
+      }
+      if (bDone) {
+         continue;
+      }
+
+      __speedOpenType *pOpen = (pFree != NULL) ? pFree : pOldest; //start of a passage
+      memcpy(pOpen->uid, ucUid, UID_LEN);
+      pOpen->time = ulReadTime;
+      pOpen->port = port;
+   }
+}
+
+/*
+ * Sensor query (OPC_SW_REQ to the address 1017, sent by Rocrail at startup): all the
+ * boards answer with the state of their sensors
+ */
+boolean isSenQuery(lnMsg *LnRecMsg){
+   return (LnRecMsg->data[0] == OPC_SW_REQ) && (LnRecMsg->data[1] == SEN_QUERY_LOW_ADDRESS) &&
+          ((LnRecMsg->data[2] & 0x0F) == SEN_QUERY_HIGH_ADDRESS);
+}
+
+/*
+ * Report the state of the next active reader after a sensor query: the sensor message and,
+ * for an occupied port, the last reported UID (or loco). One reader per call, only while the
+ * ring has room for the new tags. The report starts in a random slot, so the boards of a
+ * layout don't answer at once. The messages are appended (lnRingAppend): they must not replace
+ * each other, and a later message of the port must not replace one queued before them.
+ * Called from loop() while uiSenQueryPort != LN_NO_PORT
+ */
+void senQueryProcess(void){
+   if ((int32_t)(millis() - ulSenQueryTime) < 0) {
+      return;
+   }
+   if (lnRingCount() > (LN_BUFF_LEN - SEN_QUERY_RING_FREE)) {
+      return;
+   }
+
+   uint8_t port = uiSenQueryPort;
+   while ((port < NR_OF_RFID_PORTS) && !rfidPorts[port].bActive) {
+      port++;
+   }
+   if (port >= NR_OF_RFID_PORTS) { //all the readers reported
+      uiSenQueryPort = LN_NO_PORT;
+      return;
+   }
+
+   __rfidPortType *pPort = &rfidPorts[port];
+   boolean bOccupied = (pPort->presState != PRES_FREE); //the free report of PRES_HELD is not sent yet
+   lnMsg *pTxMsg = lnRingAppend(port);
+   if (pTxMsg != NULL) {
+      buildSensorMessage(port, bOccupied, pTxMsg);
+      lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = 0;
+      lnRingCommit();
+   }
+
+   if (bOccupied) {
+      pTxMsg = lnRingAppend(port);
+      if (pTxMsg != NULL) {
+#if UID_TABLE
+         if (pPort->locoAddr != 0) {
+            buildTranspMessage(port, pPort->locoAddr, true, pTxMsg);
+         } else
+#endif
+         {
+            MFRC522::Uid uid;
+            uid.size = UID_LEN; //oldUid is zero filled
+            memcpy(uid.uidByte, pPort->oldUid, UID_LEN);
+            buildLnMessage(uid, port, pTxMsg);
+         }
+         lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = 0;
+         lnRingCommit();
+      }
+   }
+   uiSenQueryPort = port + 1;
+}
+
+/*
+ * True if the UID just read by the reader is the given (zero filled) UID
+ */
+static boolean isSameUid(uint8_t port, uint8_t *pUid){
+   MFRC522::Uid &uid = mfrc522[port].uid;
+
+   if (!compareUid(uid.uidByte, pUid, min(uid.size, UID_LEN))) { //a 10 byte UID: the reported 7 bytes
+      return false;
+   }
+   return (uid.size >= UID_LEN) || (pUid[uid.size] == 0);
 }
 
+#if MULTI_TAG_MODE
+/*
+ * True if the UID just read is one of the UIDs reported since the port became occupied.
+ * A new UID is remembered, overwriting the oldest one when the table is full
+ */
+static boolean isKnownUid(uint8_t port){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+   for (uint8_t i = 0; i < MULTI_TAG_MAX; i++) {
+      if (isSameUid(port, pPort->knownUid[i])) {
+         return true;
+      }
+   }
+   copyUid(mfrc522[port].uid.uidByte, pPort->knownUid[pPort->knownNext], min(mfrc522[port].uid.size, UID_LEN));
+   pPort->knownNext = (pPort->knownNext + 1) % MULTI_TAG_MAX;
+   return false;
+}
+
+/*
+ * Tags in the field answered the REQA. All of them are enumerated in one sweep: the tag winning
+ * the anticollision is read and halted; the HLTA sends the other (READY) tags back to IDLE, so
+ * they answer the next REQA. Each new tag gets its own UID message. The sweep ends when no tag
+ * answers, or after MULTI_TAG_MAX tags / MULTI_TAG_BUDGET_US; the tags left answer the REQA of
+ * the next pass.
+ */
+void readerNewTag(uint8_t port){
+   __rfidPortType *pPort = &rfidPorts[port];
+   uint32_t ulStart = micros();
+
+   if (pPort->presState == PRES_FREE) {
+      /* reported free (after the debounce time) => all the tags are reported again*/
+      memset(pPort->knownUid, 0, sizeof(pPort->knownUid));
+      pPort->knownNext = 0;
+   }
+
+   for (uint8_t n = 0; n < MULTI_TAG_MAX; n++) {
+#if PERF_MEASURE
+      perfData.rdrCalls++;
+#endif
+      rfidSpiRelease(); //the library uses its own bus settings
+      if (!mfrc522[port].PICC_ReadCardSerial()) { //no more / not readable tag
+         break;
+      }
+
+      stats.reader[port].detections++;
+      uint32_t ulReadTime = micros();
+#if USE_INTERRUPTS
+      if (n == 0) {
+         noInterrupts(); //4 bytes written by the ISR
+         ulReadTime = pPort->intTime; //the first tag answered the REQA at the interrupt
+         interrupts();
+      }
+#endif
+      if (!isKnownUid(port)) {
+         queueTagReport(port, ulReadTime);
+         copyUid(mfrc522[port].uid.uidByte, pPort->oldUid, min(mfrc522[port].uid.size, UID_LEN));
+      }
+
+      pPort->presState = PRES_PRESENT;
+      pPort->lastSeen = millis();
+
+      rfidHalt(port);
+
+      if (((micros() - ulStart) >= MULTI_TAG_BUDGET_US) || (lnRingCount() >= LN_BUFF_LEN)) {
+         break;
+      }
+      if (!rfidRequest(port, MFRC522::PICC_CMD_REQA)) { //all the tags halted
+         break;
+      }
+   }
+}
+#else
+/*
+ * True if the UID just read by the reader is the last reported one
+ */
+static boolean isReportedUid(uint8_t port){
+   return isSameUid(port, rfidPorts[port].oldUid);
+}
+
+/*
+ * A tag answered the REQA (new tag or the reported one after losing the HALT state).
+ * Read its UID, report it if it is not the reported one, and halt it, so the next
+ * REQA is answered only by other tags.
+ */
+void readerNewTag(uint8_t port){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+#if PERF_MEASURE
+   perfData.rdrCalls++;
+#endif
+   rfidSpiRelease(); //the library uses its own bus settings
+   if (!mfrc522[port].PICC_ReadCardSerial()) { //no / not readable tag
+      return;
+   }
+   stats.reader[port].detections++;
+
+   uint32_t ulReadTime = micros();
+#if USE_INTERRUPTS
+   noInterrupts(); //4 bytes written by the ISR
+   ulReadTime = pPort->intTime; //the tag answered the REQA at the interrupt
+   interrupts();
+#endif
+   uint32_t ulNow = millis();
+
+   if (isReportedUid(port)) {
+      /* still there, or back within the debounce time (free report held) => already reported*/
+      if (pPort->presState == PRES_FREE) {
+         queueTagReport(port, ulReadTime);
+      }
+   } else { //new tag, maybe replacing the reported one without gap
+      if (pPort->presState == PRES_HELD) { //the reported tag left: its free report first
+         readerFreeReport(port);
+      }
+      queueTagReport(port, ulReadTime);
+      copyUid(mfrc522[port].uid.uidByte, pPort->oldUid, min(mfrc522[port].uid.size, UID_LEN));
+   }
+
+   pPort->presState = PRES_PRESENT;
+   pPort->lastSeen = ulNow;
+
+   rfidHalt(port);
+}
+#endif
+
+/*
+ * No tag answered the REQA. If a tag is reported, check with a WUPA (wakes the halted tag
+ * up, without anticollision / select) if it is still in the field. After the hold-off time
+ * without answer, the free report is held for the debounce time (PRES_HELD); a tag coming
+ * back within it keeps the port occupied without any message.
+ * The tag answering the WUPA stays in READY* and goes back to HALT with the next REQA.
+ */
+void readerCheckPresence(uint8_t port){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+   if (pPort->presState == PRES_PRESENT) {
+      boolean bAnswer = rfidRequest(port, MFRC522::PICC_CMD_WUPA);
+
+      uint32_t ulNow = millis();
+      if (bAnswer) {
+         pPort->lastSeen = ulNow;
+      } else if ((ulNow - pPort->lastSeen) >= (10UL * svCfgRead(SV_CFG_HOLDOFF, PRES_HOLDOFF_DEF))) {
+         pPort->presState = PRES_HELD;
+         pPort->freeTime = ulNow;
+      }
+   }
+   if ((pPort->presState == PRES_HELD) && 
+       ((millis() - pPort->freeTime) >= svCfgRead(SV_CFG_DEBOUNCE, PRES_DEBOUNCE_DEF))) {
+      readerFreeReport(port);
+   }
+}
+
+/*
+ * The tag didn't come back within the debounce time: the port is reported free
+ */
+void readerFreeReport(uint8_t port){
+   rfidPorts[port].presState = PRES_FREE;
+   queueSensorState(port, false);
+   dbgLog(DBG_EV_FREE, port, NULL, 0);
+#if UID_TABLE
+   queueTranspAbsent(port);
+#endif
+}
+
+/*
+ * Direct register access of the readers. The register enums of the library are already
+ * shifted left by 1 => address byte = reg & 0x7E for a write, 0x80 | reg for a read.
+ * A dedicated reader keeps its bus transaction open until another reader or the library
+ * needs the bus (uiSpiOwner); a shared reader closes it after each burst.
+ */
+static uint8_t uiSpiOwner = LN_NO_PORT; //dedicated reader holding the open bus transaction
+
+/* bus settings and pins of the reader, without any reader access*/
+void rfidReaderAttach(uint8_t port, uint8_t ssPin, uint32_t ulClock){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+   pPort->spiSettings = SPISettings(ulClock, MSBFIRST, SPI_MODE0);
+   pPort->ssPin = ssPin;
+   pPort->bSpiDedicated = ((RFID_SPI_DEDICATED >> port) & 0x01) != 0;
+#if PERF_MEASURE
+   pPort->spiTrans = 0;
+   pPort->spiBytes = 0;
+#endif
+
+   mfrc522[port] = MFRC522(ssPin, RST_PIN);
+   pinMode(ssPin, OUTPUT);
+   digitalWrite(ssPin, HIGH); //deselected
+}
+
+/* library initialisation; waits for the reset of the reader (~50 ms)*/
+void rfidReaderInit(uint8_t port, uint8_t ssPin, uint32_t ulClock){
+   rfidReaderAttach(port, ssPin, ulClock);
+
+   rfidSpiRelease();
+   mfrc522[port].PCD_Init(ssPin, RST_PIN);
+   stats.reader[port].resets++;
+}
+
+/*
+ * The register values of MFRC522::PCD_Init(), written in one burst: 106 kBd, 25 ms timeout,
+ * 100% ASK, CRC preset 0x6363, antenna on (TxControlReg reset value 0x80 | 0x03)
+ */
+static const uint8_t rfidInitRegs[] = {
+   MFRC522::TxModeReg, 0x00,  MFRC522::RxModeReg, 0x00,  MFRC522::ModWidthReg, 0x26,
+   MFRC522::TModeReg, 0x80,  MFRC522::TPrescalerReg, 0xA9,
+   MFRC522::TReloadRegH, 0x03,  MFRC522::TReloadRegL, 0xE8,
+   MFRC522::TxASKReg, 0x40,  MFRC522::ModeReg, 0x3D,  MFRC522::TxControlReg, 0x83
+};
+
+/* configure a reader already out of reset (common reset or hot plugged), without waiting*/
+void rfidReaderConfig(uint8_t port){
+   rfidWriteRegs(port, rfidInitRegs, sizeof(rfidInitRegs) / 2);
+   stats.reader[port].resets++;
+}
+
+/* soft reset of one reader, without waiting; it can be configured after RFID_RESET_MS*/
+void rfidReaderReset(uint8_t port){
+   const uint8_t regCmd[] = {MFRC522::CommandReg, MFRC522::PCD_SoftReset};
+
+   rfidWriteRegs(port, regCmd, 1);
+}
+
+/* the reader is still in its reset (PowerDown bit of CommandReg)*/
+boolean rfidReaderInReset(uint8_t port){
+   const uint8_t regCmd = MFRC522::CommandReg;
+   uint8_t ucCmd;
+
+   rfidReadRegs(port, &regCmd, 1, &ucCmd);
+   return (ucCmd & (1 << 4)) != 0;
+}
+
+/* VersionReg of the reader; 0 if no reader answers (0x00 / 0xFF)*/
+uint8_t rfidReaderProbe(uint8_t port){
+   const uint8_t regVer = MFRC522::VersionReg;
+   uint8_t ucVer;
+
+   rfidReadRegs(port, &regVer, 1, &ucVer);
+   return (ucVer == 0xFF) ? 0 : ucVer;
+}
+
+/* one hard reset for all the readers (common RST pin); they can be configured after RFID_RESET_MS*/
+void rfidResetAll(void){
+   pinMode(RST_PIN, OUTPUT);
+   digitalWrite(RST_PIN, LOW);
+   delayMicroseconds(2); //reset pulse > 100 ns
+   digitalWrite(RST_PIN, HIGH);
+   ulRfidResetTime = millis();
+}
+
+/*
+ * Close the bus transaction kept open by a dedicated reader. Needed before any library call
+ */
+void rfidSpiRelease(void){
+   if (uiSpiOwner != LN_NO_PORT) {
+      SPI.endTransaction();
+      uiSpiOwner = LN_NO_PORT;
+   }
+}
+
+static void rfidSpiBegin(uint8_t port){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+#if PERF_MEASURE
+   pPort->spiTrans++;
+#endif
+   if (uiSpiOwner == port) { //dedicated reader, bus already set
+      return;
+   }
+   rfidSpiRelease();
+   SPI.beginTransaction(pPort->spiSettings);
+   if (pPort->bSpiDedicated) {
+      uiSpiOwner = port;
+   }
+}
+
+static void rfidSpiEnd(uint8_t port){
+   if (uiSpiOwner != port) {
+      SPI.endTransaction();
+   }
+}
+
+/* one chip select frame: the address byte, then n bytes written in the same register (FIFO)*/
+static void rfidWriteFrame(uint8_t port, uint8_t reg, const uint8_t *pData, uint8_t n){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+   digitalWrite(pPort->ssPin, LOW);
+   SPI.transfer(reg & 0x7E);
+   for (uint8_t i = 0; i < n; i++) {
+      SPI.transfer(pData[i]);
+   }
+   digitalWrite(pPort->ssPin, HIGH);
+#if PERF_MEASURE
+   pPort->spiBytes += n + 1;
+#endif
+}
+
+/*
+ * Write n registers (register, value pairs) in one bus transaction. The MFRC522 writes all
+ * the bytes of a frame in the same register => one frame per register
+ */
+void rfidWriteRegs(uint8_t port, const uint8_t *pRegVal, uint8_t n){
+   rfidSpiBegin(port);
+   for (uint8_t i = 0; i < n; i++) {
+      rfidWriteFrame(port, pRegVal[2 * i], &pRegVal[2 * i + 1], 1);
+   }
+   rfidSpiEnd(port);
+}
+
+/*
+ * Read n (max RFID_BURST_MAX) registers in one frame: each address byte clocks out the value
+ * of the previous register, a final 0x00 the value of the last one
+ */
+void rfidReadRegs(uint8_t port, const uint8_t *pRegs, uint8_t n, uint8_t *pOut){
+   __rfidPortType *pPort = &rfidPorts[port];
+   uint8_t ucBuff[RFID_BURST_MAX + 1];
+
+   for (uint8_t i = 0; i < n; i++) {
+      ucBuff[i] = 0x80 | pRegs[i];
+   }
+   ucBuff[n] = 0x00;
+
+   rfidSpiBegin(port);
+   digitalWrite(pPort->ssPin, LOW);
+   SPI.transfer(ucBuff, n + 1);
+   digitalWrite(pPort->ssPin, HIGH);
+   rfidSpiEnd(port);
+#if PERF_MEASURE
+   pPort->spiBytes += n + 1;
+#endif
+
+   memcpy(pOut, &ucBuff[1], n);
+}
+
+/*
+ * Send a REQA / WUPA and wait for the ATQA. Replaces PICC_IsNewCardPresent() / PICC_WakeupA():
+ * the request is one transaction, each status poll one frame, and no answer costs
+ * RFID_REQ_TIMEOUT_US instead of the 25 ms timer of the library.
+ * Returns true if a tag answered (a collision => more tags answered)
+ */
+boolean rfidRequest(uint8_t port, uint8_t ucCmd){
+   const uint8_t regVals[] = {
+      MFRC522::CommandReg,    MFRC522::PCD_Idle,
+      MFRC522::ComIrqReg,     0x7F,
+      MFRC522::FIFOLevelReg,  0x80,
+      MFRC522::FIFODataReg,   ucCmd,
+      MFRC522::BitFramingReg, 0x07,   //short frame: 7 bits
+      MFRC522::CommandReg,    MFRC522::PCD_Transceive,
+      MFRC522::BitFramingReg, 0x87};  //StartSend
+   const uint8_t regs[] = {MFRC522::ComIrqReg, MFRC522::ErrorReg, MFRC522::FIFOLevelReg};
+   uint8_t ucVals[sizeof(regs)];
+
+   rfidWriteRegs(port, regVals, sizeof(regVals) / 2);
+
+   uint32_t ulStart = micros();
+   do {
+      rfidReadRegs(port, regs, sizeof(regs), ucVals);
+      if (ucVals[0] & 0x20) { //RxIRq: answer received
+         if (ucVals[1] & 0x08) { //CollErr
+            return true;
+         }
+         return ((ucVals[1] & 0x13) == 0) && (ucVals[2] == 2); //no BufferOvfl / ParityErr / ProtocolErr; 2 bytes ATQA
+      }
+      if (ucVals[0] & 0x01) { //TimerIRq
+         break;
+      }
+   } while ((micros() - ulStart) < RFID_REQ_TIMEOUT_US);
+
+   const uint8_t regIdle[] = {MFRC522::CommandReg, MFRC522::PCD_Idle};
+   rfidWriteRegs(port, regIdle, 1);
+   return false;
+}
+
+/*
+ * Send the HLTA with the precalculated CRC (no CRC coprocessor round trip) and wait only for
+ * the end of the transmission; the tag does not answer a HLTA
+ */
+void rfidHalt(uint8_t port){
+   static const uint8_t hltaFrame[] = {MFRC522::PICC_CMD_HLTA, 0x00, 0x57, 0xCD};
+   const uint8_t ucIdle = MFRC522::PCD_Idle;
+   const uint8_t ucIrqClr = 0x7F;
+   const uint8_t ucFlush = 0x80;
+   const uint8_t ucFraming = 0x00;
+   const uint8_t ucTransmit = MFRC522::PCD_Transmit;
+   const uint8_t regs[] = {MFRC522::ComIrqReg};
+   uint8_t ucIrq;
+
+   rfidSpiBegin(port);
+   rfidWriteFrame(port, MFRC522::CommandReg, &ucIdle, 1);
+   rfidWriteFrame(port, MFRC522::ComIrqReg, &ucIrqClr, 1);
+   rfidWriteFrame(port, MFRC522::FIFOLevelReg, &ucFlush, 1);
+   rfidWriteFrame(port, MFRC522::FIFODataReg, hltaFrame, sizeof(hltaFrame));
+   rfidWriteFrame(port, MFRC522::BitFramingReg, &ucFraming, 1);
+   rfidWriteFrame(port, MFRC522::CommandReg, &ucTransmit, 1);
+   rfidSpiEnd(port);
+
+   uint32_t ulStart = micros();
+   do {
+      rfidReadRegs(port, regs, 1, &ucIrq);
+   } while (!(ucIrq & 0x40) && ((micros() - ulStart) < RFID_HALT_TIMEOUT_US)); //TxIRq
+}
+
+/*
+ * Load the RAM mirror of the SV storage. Called once, after boardSetup()
+ */
+void svMirrorInit(void){
+   svMirror[0] = 0; //no SV 0
+   for (uint16_t i = SV_ADDR_EEPROM_SIZE; i < SV_MIRROR_LEN; i++) {
+      svMirror[i] = sv.readSVStorage(i);
+   }
+   for (uint8_t i = 0; i < SV_DIRTY_LEN; i++) {
+      svDirty[i] = 0;
+   }
+   uiPortsChanged = 0;
+}
+
+/*
+ * Read one SV: from RAM if mirrored, from EEPROM otherwise
+ */
+uint8_t svRead(uint16_t offset){
+   if (offset < SV_MIRROR_LEN) {
+      return svMirror[offset];
+   }
+   if ((offset >= SV_ADDR_USER_BASE + SV_STAT_BASE) && (offset < SV_ADDR_USER_BASE + SV_STAT_BASE + SV_STAT_LEN)) {
+      return statsRead(offset - SV_ADDR_USER_BASE - SV_STAT_BASE);
+   }
+   return sv.readSVStorage(offset);
+}
+
+/*
+ * Write one SV in RAM. The EEPROM is written later, by svFlush(). If the SV belongs
+ * to a reader port, the port is marked for the sensor address recalculation
+ */
+void svWrite(uint16_t offset, uint8_t value){
+   if (offset >= SV_MIRROR_LEN) { //not mirrored => direct write
+      sv.writeSVStorage(offset, value);
+      stats.eeWrites++;
+      return;
+   }
+   if (offset < SV_ADDR_NODE_ID_L) { //EEPROM size & SW version are read only
+      return;
+   }
+
+   if (svMirror[offset] != value) {
+      svMirror[offset] = value;
+      svDirty[offset >> 3] |= 1 << (offset & 0x07);
+
+      if (offset >= SV_ADDR_USER_BASE + 3) {
+         uint16_t port = (offset - SV_ADDR_USER_BASE - 3) / 3;
+         if (port < NR_OF_RFID_PORTS) {
+            uiPortsChanged |= 1 << port;
+         } else if (port < TOTAL_NR_OF_PORTS) {
+            bUpdateOutputs = true; //output port changed => rebuild the outputs index
+         }
+      }
+   }
+}
+
+/*
+ * Write in EEPROM the first changed SV. One EEPROM write per call, so the caller
+ * (loop(), when nothing is waiting to be sent) is never blocked for long.
+ * Return true if a SV was written
+ */
+boolean svFlush(void){
+   for (uint8_t i = 0; i < SV_DIRTY_LEN; i++) {
+      if (svDirty[i] != 0) {
+         for (uint8_t j = 0; j < 8; j++) {
+            if (svDirty[i] & (1 << j)) {
+               uint16_t offset = (i << 3) + j;
+               svDirty[i] &= ~(1 << j);
+               sv.writeSVStorage(offset, svMirror[offset]);
+               stats.eeWrites++;
+               return true;
+            }
+         }
+      }
+   }
+   return false;
+}
+
+/*
+ * Recalculate the sensor address (and the UID message header) of the ports whose SVs changed
+ */
+void svApplyChanges(void){
+   if (bUpdateOutputs) {
+      outputsInit();
+   }
+   for (uint8_t i = 0; (uiPortsChanged != 0) && (i < NR_OF_RFID_PORTS); i++) {
+      if (uiPortsChanged & (1 << i)) {
+         uiPortsChanged &= ~(1 << i);
+         calcSenAddr(i);
+
+#ifdef _SER_DEBUG
+         if (bSerialOk) {
+            printSensorData(i);
+         }
+#endif
+      }
+   }
+}
+
+/*
+ * Number of messages waiting in the send ring
+ */
+uint8_t lnRingCount(void){
+   return (uint8_t)(lnTxRing.head - lnTxRing.tail);
+}
+
+/*
+ * Producer side: return the slot to fill, or NULL if the ring is full (counted as overflow).
+ * With LN_BUFF_COALESCE the slot of a port message not yet sent is returned again.
+ * The message becomes visible to the consumer only after lnRingCommit()
+ */
+lnMsg *lnRingAlloc(uint8_t port){
+#if LN_BUFF_COALESCE
+   if (port < NR_OF_RFID_PORTS) {
+      uint8_t uiIdx = lnTxRing.pending[port];
+      uint8_t uiAge = uiIdx - lnTxRing.tail;
+
+      /* still waiting, not the one in sending and not reused by another port*/
+      if ((uiAge > 0) && (uiAge < lnRingCount()) && (lnTxRing.slotPort[uiIdx & LN_BUFF_MASK] == port)) {
+         lnTxRing.wrIdx = uiIdx;
+         lnTxRing.coalesced++;
+         return &lnTxRing.msg[uiIdx & LN_BUFF_MASK];
+      }
+   }
+#endif
+
+   if (lnRingCount() >= LN_BUFF_LEN) {
+      lnTxRing.overflows++;
+      return NULL;
+   }
+
+   lnTxRing.wrIdx = lnTxRing.head;
+#if LN_BUFF_COALESCE
+   lnTxRing.slotPort[lnTxRing.head & LN_BUFF_MASK] = port;
+   if (port < NR_OF_RFID_PORTS) {
+      lnTxRing.pending[port] = lnTxRing.head;
+   }
+#endif
+   return &lnTxRing.msg[lnTxRing.head & LN_BUFF_MASK];
+}
+
+/*
+ * Producer side, message of the port that is never replaced (each one has to be sent, e.g. one
+ * of a sequence). The waiting message of the port before it can't be replaced any more either,
+ * so the messages of a port are always sent in their order
+ */
+lnMsg *lnRingAppend(uint8_t port){
+   lnMsg *pMsg = lnRingAlloc(LN_NO_PORT);
+#if LN_BUFF_COALESCE
+   if ((pMsg != NULL) && (port < NR_OF_RFID_PORTS)) {
+      lnTxRing.pending[port] = lnTxRing.wrIdx; //its slotPort is LN_NO_PORT => not replaceable
+   }
+#endif
+   return pMsg;
+}
+
+void lnRingCommit(void){
+   LN_RING_BARRIER();
+   if (lnTxRing.wrIdx != lnTxRing.head) { //a waiting message was replaced
+      return;
+   }
+   lnTxRing.head = lnTxRing.head + 1;
+
+   uint8_t uiCnt = lnRingCount();
+   if (uiCnt > lnTxRing.highWater) {
+      lnTxRing.highWater = uiCnt;
+   }
+}
+
+/*
+ * Consumer side: the oldest message, or NULL if the ring is empty. The message stays in
+ * the ring until lnRingRelease(), so a failed send can be retried
+ */
+lnMsg *lnRingPeek(void){
+   if (lnTxRing.head == lnTxRing.tail) {
+      return NULL;
+   }
+   LN_RING_BARRIER();
+   return &lnTxRing.msg[lnTxRing.tail & LN_BUFF_MASK];
+}
+
+void lnRingRelease(void){
+   LN_RING_BARRIER();
+   lnTxRing.tail = lnTxRing.tail + 1;
+}
+
+/*
+ * Queue of the SV replies: the reply is built directly in the slot, then committed.
+ * NULL if the queue is full (the reply is lost; the programming tool repeats the request)
+ */
+lnMsg *lnTxSvAlloc(void){
+   if ((uint8_t)(lnTx.svHead - lnTx.svTail) >= LN_SV_BUFF_LEN) {
+      return NULL;
+   }
+   return &lnTx.svMsg[lnTx.svHead & LN_SV_BUFF_MASK];
+}
+
+void lnTxSvCommit(void){
+   lnTx.svHead++;
+}
+
+/*
+ * Message in sending (SV reply or lnTxRing tail) is done: sent or dropped
+ */
+static void lnTxDone(LN_STATUS lnSent){
+   stats.sendStatus[lnSent]++;
+
+   if (lnTx.state == LN_TX_SV) {
+      lnTx.svTail++;
+   } else {
+      uint32_t ulTagTime = lnTxRing.tagTime[lnTxRing.tail & LN_BUFF_MASK];
+      if ((lnSent == LN_DONE) && (ulTagTime != 0)) {
+         uint32_t ulLatency = micros() - ulTagTime;
+         uint16_t uiLat100us = (ulLatency >= 6553500UL) ? 0xFFFF : (ulLatency / 100);
+         if (uiLat100us > stats.latMax) {
+            stats.latMax = uiLat100us;
+         }
+#if PERF_MEASURE
+         perfData.latSum += ulLatency;
+         if (ulLatency > perfData.latMax) {
+            perfData.latMax = ulLatency;
+         }
+         perfData.latCnt++;
+#endif
+      }
+      lnRingRelease();
+   }
+   lnTx.state = LN_TX_IDLE;
+}
+
+/*
+ * Priority delay of the first attempt, per the SV_CFG_PRIO policy. The default (legacy policy,
+ * 10 levels) is the delay of the older versions
+ */
+static uint8_t lnTxPrioDelay(void){
+   uint8_t ucLevels = svCfgRead(SV_CFG_PRIO_LVL, LN_PRIO_LVL_DEF);
+   uint8_t ucPolicy = svCfgRead(SV_CFG_PRIO, LN_PRIO_LEGACY);
+   uint8_t ucLevel;
+
+   if ((ucLevels == 0) || (ucLevels > (LN_BACKOFF_MAX - LN_BACKOFF_MIN + 1))) {
+      ucLevels = LN_BACKOFF_MAX - LN_BACKOFF_MIN + 1;
+   }
+
+   if (ucPolicy == LN_PRIO_LEGACY) {
+      ucLevel = ucBoardAddrLo % ucLevels;
+   } else {
+      uint16_t uiHash = (svRead(SV_ADDR_SERIAL_NUMBER_H) << 8) | svRead(SV_ADDR_SERIAL_NUMBER_L);
+      uiHash ^= (ucBoardAddrHi << 7) | ucBoardAddrLo;
+      uiHash ^= uiHash >> 7;
+      uiHash *= 0x9E37;  //spreads the near addresses / serial numbers
+      ucLevel = (uiHash >> 8) % ucLevels;
+   }
+
+   uint8_t ucDelay = LN_BACKOFF_MAX - ucLevel;
+   if (ucPolicy == LN_PRIO_QUEUE) {
+      uint8_t ucWaiting = lnRingCount() + (uint8_t)(lnTx.svHead - lnTx.svTail);
+      ucDelay = (ucDelay - LN_BACKOFF_MIN > ucWaiting) ? ucDelay - ucWaiting : LN_BACKOFF_MIN;
+   }
+   return ucDelay;
+}
+
+/*
+ * One step of the transmitter, called from every loop() pass. The same steps as
+ * LocoNet.send(), but returning while the bus is in backoff: an attempt fails on collision
+ * or busy bus after the backoff; the next attempt has a smaller priority delay (higher
+ * priority). After LN_TX_TRIES failed attempts the message is dropped (LN_RETRY_ERROR).
+ */
+void lnTxProcess(void){
+   lnMsg *pMsg;
+
+   if (lnTx.state == LN_TX_IDLE) {
+      if (lnTx.svHead != lnTx.svTail) {
+         lnTx.state = LN_TX_SV;
+      } else if (lnRingPeek() != NULL) {
+         lnTx.state = LN_TX_SENSOR;
+      } else {
+         return;
+      }
+      lnTx.prioDelay = lnTxPrioDelay(); //trying to differentiate the ln answer time
+      lnTx.tries = 0;
+      lnTx.bWaitBackoff = true;
+   }
+
+   if (lnTx.state == LN_TX_SV) {
+      pMsg = &lnTx.svMsg[lnTx.svTail & LN_SV_BUFF_MASK];
+   } else {
+      pMsg = lnRingPeek();
+   }
+
+   LN_STATUS lnSent = sendLocoNetPacketTry(pMsg, lnTx.prioDelay);
+
+   switch (lnSent) {
+      case LN_DONE:
+#ifdef _SER_DEBUG
+         dbgLog(DBG_EV_LN_TX, LN_NO_PORT, pMsg->data, UID_LEN);
+#endif
+         lnTxDone(LN_DONE);
+         return;
+
+      case LN_CD_BACKOFF:
+         return; //carrier detect backoff; try again in the next pass
+
+      case LN_PRIO_BACKOFF:
+         lnTx.bWaitBackoff = false; //backoff entered => the next busy bus is a failed attempt
+         return;
+
+      case LN_NETWORK_BUSY:
+         if (lnTx.bWaitBackoff) { //traffic not yet finished
+            return;
+         }
+         break;
+
+      default: //LN_COLLISION, LN_UNKNOWN_ERROR
+         break;
+   }
+
+   /* failed attempt*/
+   if (lnSent <= LN_RETRY_ERROR) {
+      stats.sendStatus[lnSent]++;
+   }
+   lnTx.tries++;
+   if (lnTx.tries >= LN_TX_TRIES) {
+      dbgLog(DBG_EV_LN_DROP, LN_NO_PORT, pMsg->data, UID_LEN);
+      lnTxDone(LN_RETRY_ERROR);
+      return;
+   }
+   if (lnTx.prioDelay > LN_BACKOFF_MIN) {
+      lnTx.prioDelay--;
+   }
+   lnTx.bWaitBackoff = true;
+}
+
+#if DBG_LOG
+static __dbgLogType dbgLogRing;
+
+void dbgLog(uint8_t code, uint8_t port, const uint8_t *pData, uint8_t len){
+   if (!bSerialOk) {
+      return;
+   }
+   if ((uint8_t)(dbgLogRing.head - dbgLogRing.tail) >= DBG_LOG_LEN) {
+      dbgLogRing.dropped++;
+      return;
+   }
+
+   __dbgEventType *pEv = &dbgLogRing.ev[dbgLogRing.head & DBG_LOG_MASK];
+   pEv->time = millis();
+   pEv->code = code;
+   pEv->port = port;
+   pEv->len = min(len, UID_LEN);
+   if (pEv->len != 0) {
+      memcpy(pEv->data, pData, pEv->len);
+   }
+   dbgLogRing.head++;
+}
+
+/*
+ * Print the oldest logged event on Serial. Called from loop() when nothing waits to be sent
+ */
+void dbgLogDrain(void){
+   if (dbgLogRing.head == dbgLogRing.tail) {
+      if (dbgLogRing.dropped != 0) {
+         Serial.print(F("Dropped events: "));
+         Serial.println(dbgLogRing.dropped);
+         dbgLogRing.dropped = 0;
+      }
+      return;
+   }
+
+   __dbgEventType *pEv = &dbgLogRing.ev[dbgLogRing.tail & DBG_LOG_MASK];
+   Serial.print(pEv->time);
+   switch (pEv->code) {
+      case DBG_EV_TAG:     Serial.print(F(" Card UID")); break;
+      case DBG_EV_FREE:    Serial.print(F(" Free")); break;
+      case DBG_EV_LN_TX:   Serial.print(F(" LN send mess")); break;
+      case DBG_EV_LN_DROP: Serial.print(F(" LN mess dropped")); break;
+      case DBG_EV_SV:      Serial.print(F(" SV request")); break;
+      default:             Serial.print(F(" Event ")); Serial.print(pEv->code); break;
+   }
+   if (pEv->port != LN_NO_PORT) {
+      Serial.print(F(" port "));
+      Serial.print(pEv->port);
+   }
+   Serial.print(':');
+   dump_byte_array(pEv->data, pEv->len);
+   Serial.println();
+   dbgLogRing.tail++;
+}
+#endif
+
+/*
+ * Build outputs[] and its address index from the port SVs. Called at startup and when an
+ * output port SV is changed. Only the pins of the output ports are driven; an output whose
+ * pin and switch address are unchanged keeps its state, the others start LOW
+ */
+static uint8_t outHash[OUT_HASH_LEN]; //outputs[] index + 1 by switch address; 0 = empty
+
+void outputsInit(void){
+   __outType prevOuts[TOTAL_NR_OF_PORTS - NR_OF_RFID_PORTS];
+   uint8_t prevNr = outsNr;
+   uint8_t j = 0;
+
+   memcpy(prevOuts, outputs, prevNr * sizeof(outputs[0]));
+   outsNr = 0;
+   memset(outHash, 0, sizeof(outHash));
+
+   for (uint8_t port = NR_OF_RFID_PORTS; port < TOTAL_NR_OF_PORTS; port++) {
+      uint8_t k = port - NR_OF_RFID_PORTS;
+      if (k >= outPinsNr) {
+         break;
+      }
+      uint8_t pin = pgm_read_byte(&outPins[k]);
+      uint16_t offset = SV_ADDR_USER_BASE + 3 + 3 * port;
+      if (pin == 0xFF) {
+         continue;
+      }
+      if (svRead(offset) != OUT_PORT_TYPE) {
+         pinMode(pin, INPUT);
+         continue;
+      }
+
+      __outType *pOut = &outputs[outsNr];
+      pOut->idx = port;
+      pOut->pin = pin;
+      pOut->addr = (((svRead(offset + 2) & 0x0F) << 7) | (svRead(offset + 1) & 0x7F)) + 1;
+      pOut->dir = svRead(offset + 2) & 0x20;
+      while ((j < prevNr) && (prevOuts[j].idx < port)) { //both sorted by port
+         j++;
+      }
+      if ((j < prevNr) && (prevOuts[j].idx == port) && (prevOuts[j].pin == pin) && (prevOuts[j].addr == pOut->addr)) {
+         pOut->state = prevOuts[j].state; //already driven
+      } else {
+         pOut->state = LOW;
+         pinMode(pin, OUTPUT);
+         digitalWrite(pin, LOW);
+      }
+
+      uint8_t h = pOut->addr & OUT_HASH_MASK;
+      while (outHash[h] != 0) {
+         h = (h + 1) & OUT_HASH_MASK;
+      }
+      outsNr++;
+      outHash[h] = outsNr;
+   }
+   bUpdateOutputs = false;
+}
+
+/*
+ * OPC_SW_REQ: drive the outputs of the switch address (pin on if the direction is the
+ * direction of the port; only the "on" requests are used). OPC_SW_STATE: answer with
+ * OPC_LONG_ACK, the closed / thrown state in ACK1. Messages for other addresses stop at the
+ * first empty slot of the index
+ */
+void outputsSwMessage(lnMsg *LnPacket){
+   uint8_t ucSw2 = LnPacket->data[2];
+   uint16_t uiAddr = (((ucSw2 & 0x0F) << 7) | LnPacket->data[1]) + 1;
+   uint8_t h = uiAddr & OUT_HASH_MASK;
+   uint8_t ucAck = 0;
+
+   for (uint8_t n = 0; (n < OUT_HASH_LEN) && (outHash[h] != 0); n++, h = (h + 1) & OUT_HASH_MASK) {
+      __outType *pOut = &outputs[outHash[h] - 1];
+      if (pOut->addr != uiAddr) {
+         continue;
+      }
+      if ((LnPacket->data[0] == OPC_SW_REQ) && (ucSw2 & 0x10)) {
+         pOut->state = ((ucSw2 & 0x20) == pOut->dir) ? HIGH : LOW;
+         digitalWrite(pOut->pin, pOut->state);
+      }
+      ucAck = ((pOut->state == HIGH) == (pOut->dir != 0)) ? OUT_ACK_CLOSED : OUT_ACK_THROWN;
+   }
+
+   if ((LnPacket->data[0] == OPC_SW_STATE) && (ucAck != 0)) {
+      lnMsg *pReply = lnTxSvAlloc();
+      if (pReply != NULL) {
+         pReply->data[0] = OPC_LONG_ACK;
+         pReply->data[1] = OPC_SW_STATE & 0x7F;
+         pReply->data[2] = ucAck;
+         pReply->data[3] = lnCalcCheckSumm(pReply->data, 4);
+         lnTxSvCommit();
+      }
+   }
+}
+
+/* health report of the port (LN_HEALTH_TYPE); appended, so the messages of the port keep their order*/
+static void queueHealthReport(uint8_t port, uint8_t ucState, uint16_t uiTime){
+   lnMsg *pTxMsg = lnRingAppend(port);
+   if (pTxMsg != NULL) {
+      uint8_t *pData = pTxMsg->data;
+      pData[0] = 0xE4;
+      pData[1] = LN_HEALTH_LEN;
+      pData[2] = LN_HEALTH_TYPE;
+      pData[3] = rfidPorts[port].addrHiSen;
+      pData[4] = rfidPorts[port].addrLoSen;
+      pData[5] = ucState;
+      pData[6] = (uiTime >> 7) & 0x7F;
+      pData[7] = uiTime & 0x7F;
+      pData[8] = lnCalcCheckSumm(pData, LN_HEALTH_LEN);
+      lnTxRing.tagTime[lnTxRing.wrIdx & LN_BUFF_MASK] = 0;
+      lnRingCommit();
+   }
+}
+
+/*
+ * Put a detected reader in the round robin: sensor address, interrupt, presence cache.
+ * Also used for a hot plugged reader, and for a reader answering again after a health failure
+ */
+void readerActivate(uint8_t port, uint8_t ucVer){
+   if ((uiActReaders == 0) || (port < uiFirstReaderIdx)) { //the first active reader
+      uiFirstReaderIdx = port;
+   }
+   if (uiActReaders == 0) {
+      uiRfidPort = port; //initialize the starting reader counter
+   }
+   uiActReaders++;
+   rfidPorts[port].bActive = true;
+   calcSenAddr(port);
+
+#if USE_INTERRUPTS
+   uint8_t irqPin = pgm_read_byte(&mfrc522Irq[port]);
+   pinMode(irqPin, INPUT_PULLUP);
+
+   /* 
+    *  Allow only the RxIrq to be propagated to the IRQ pin (open drain, active low)
+    */
+   const uint8_t regIEn[] = {MFRC522::ComIEnReg, regVal};
+   rfidWriteRegs(port, regIEn, 1);
+
+   rfidPorts[port].bNewInt = false;
+   attachReaderIsr(port, irqPin);
+
+   rearmReader(port); //first REQA; the next ones are sent by loop()
+#endif
+
+   if (rfidPorts[port].bFailed) { //back after a health failure
+      uint32_t ulOut = (millis() - rfidPorts[port].failTime) / 100;
+      if (ulOut > 0x3FFF) {
+         ulOut = 0x3FFF;
+      }
+      if (ulOut > stats.recoveryMax) {
+         stats.recoveryMax = ulOut;
+      }
+      rfidPorts[port].bFailed = false;
+      queueHealthReport(port, HEALTH_RECOVERED, ulOut);
+   }
+
+   if (svRead(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + port) != ucVer) { //written in EEPROM only if changed
+      svWrite(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + port, ucVer);
+   }
+
+   if (bSerialOk) {
+      Serial.print(F("Reader "));
+      Serial.print(port + 1);
+      Serial.print(F(" present; version = "));
+      Serial.println(ucVer, HEX);
+      printSensorData(port);
+   }
+}
+
+/*
+ * Take a failed reader out of the round robin; readerProbeProcess() puts it back when it
+ * answers again
+ */
+void readerDeactivate(uint8_t port){
+   __rfidPortType *pPort = &rfidPorts[port];
+
+   pPort->bActive = false;
+   pPort->bFailed = true;
+   pPort->failTime = millis();
+   uiActReaders--;
+#if USE_INTERRUPTS
+   detachInterrupt(digitalPinToInterrupt(pgm_read_byte(&mfrc522Irq[port])));
+   pPort->bNewInt = false;
+#endif
+
+   if (uiActReaders != 0) {
+      if (uiFirstReaderIdx == port) {
+         uiFirstReaderIdx = nextReader(port); //the readers before port are inactive
+      }
+      if (uiRfidPort == port) {
+         uiRfidPort = nextReader(port);
+      }
+   }
+   queueHealthReport(port, HEALTH_FAILED, 0);
+}
+
+/* health check registers: the reader answers and keeps its configuration (antenna on, timer auto)*/
+static const uint8_t healthRegs[] = {MFRC522::VersionReg, MFRC522::TxControlReg, MFRC522::TModeReg};
+
+static boolean readerHealthy(uint8_t port, uint8_t ucVer){
+   uint8_t ucVal[sizeof(healthRegs)];
+
+   rfidReadRegs(port, healthRegs, sizeof(healthRegs), ucVal);
+   return (ucVal[0] == ucVer) && ((ucVal[1] & 0x03) == 0x03) && (ucVal[2] == 0x80);
+}
+
+static uint8_t uiResetPort = LN_NO_PORT; //reader soft reset by the health check, configured by readerResetProcess()
+static uint32_t ulResetTime;             //millis() of that reset
+static uint8_t ucResetWaits;             //RFID_RESET_MS periods waited for the end of the reset
+
+/*
+ * End of the soft reset of a failed reader, RFID_RESET_MS after it (up to 3 periods, as
+ * PCD_Init()): the PCD_Init() register values, and back in the round robin if healthy.
+ * Otherwise readerProbeProcess() takes it back when it answers again
+ */
+static void readerResetProcess(void){
+   if ((millis() - ulResetTime) < RFID_RESET_MS) {
+      return;
+   }
+   uint8_t port = uiResetPort;
+   if (rfidReaderInReset(port) && (++ucResetWaits < 3)) {
+      ulResetTime = millis();
+      return;
+   }
+   uiResetPort = LN_NO_PORT;
+
+   uint8_t ucVer = rfidReaderProbe(port);
+   if (ucVer != 0) {
+      rfidReaderConfig(port);
+      if (readerHealthy(port, ucVer)) { //the reset was enough
+         readerActivate(port, ucVer);
+      }
+   }
+}
+
+/*
+ * Health check of the active readers, one reader every SV_CFG_HEALTH * 100 ms (one SPI burst).
+ * A failed reader gets a soft reset, finished by readerResetProcess() on a later pass; it is
+ * back in the round robin only if it is healthy afterwards. Called from every loop() pass
+ */
+void readerHealthProcess(void){
+   static uint32_t ulCheckTime = 0;
+   static uint8_t uiCheckPort = 0;
+   uint8_t ucPeriod = svCfgRead(SV_CFG_HEALTH, HEALTH_PERIOD_DEF);
+
+   if (uiResetPort != LN_NO_PORT) { //no check until the reset reader is done
+      readerResetProcess();
+      return;
+   }
+   if ((ucPeriod == 0) || (uiActReaders == 0)) {
+      return;
+   }
+   if ((millis() - ulCheckTime) < (100UL * ucPeriod)) {
+      return;
+   }
+   ulCheckTime = millis();
+
+   uint8_t port = nextReader(uiCheckPort);
+   uiCheckPort = port;
+
+   uint32_t ulStart = micros();
+   boolean bHealthy = readerHealthy(port, svRead(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + port));
+   uint32_t ulUs = micros() - ulStart;
+   if (ulUs > stats.healthUsMax) {
+      stats.healthUsMax = (ulUs > 0xFFFF) ? 0xFFFF : ulUs;
+   }
+   if (bHealthy) {
+      return;
+   }
+
+   stats.reader[port].failures++;
+   readerDeactivate(port);
+   rfidReaderReset(port);
+   uiResetPort = port;
+   ulResetTime = millis();
+   ucResetWaits = 0;
+}
+
+#if FAST_BOOT
+/*
+ * First reader detection, once the readers are out of the common reset. Only the readers
+ * present (or not probed) at the last boot are probed; the others are found by
+ * readerProbeProcess(). Called from loop() while bRfidBoot is set
+ */
+void readerBootProcess(void){
+   if ((millis() - ulRfidResetTime) < RFID_RESET_MS) {
+      return;
+   }
+   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+      if (svRead(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + i) == 0) { //absent at the last boot
+         continue;
+      }
+      uint8_t ucVer = rfidReaderProbe(i);
+      if (ucVer != 0) {
+         rfidReaderConfig(i);
+         readerActivate(i, ucVer);
+      } else {
+         svWrite(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + i, 0);
+      }
+   }
+   bRfidBoot = false;
+}
+
+/*
+ * The Serial connection (USB on the ATMEGA32U4 boards) is checked from the loop, so the
+ * readers and the LocoNet don't wait for it at startup
+ */
+void serialAttach(void){
+   static uint32_t ulPollTime = 0;
+
+   if ((millis() - ulPollTime) < SERIAL_POLL_MS) {
+      return;
+   }
+   ulPollTime = millis();
+   if (Serial) {
+      bSerialOk = true;
+      printBoardInfo();
+   }
+}
+#endif
+
+/*
+ * The inactive readers are probed in turn, one every RFID_PROBE_MS => a reader plugged in
+ * (or powered) later is put in the round robin without reboot. Called when the loop is idle
+ */
+void readerProbeProcess(void){
+   static uint32_t ulProbeTime = 0;
+   static uint8_t uiProbePort = 0;
+
+   if (uiActReaders >= NR_OF_RFID_PORTS) {
+      return;
+   }
+   if ((millis() - ulProbeTime) < RFID_PROBE_MS) {
+      return;
+   }
+   ulProbeTime = millis();
+
+   do {
+      uiProbePort = (uiProbePort + 1) % NR_OF_RFID_PORTS;
+   } while (rfidPorts[uiProbePort].bActive);
+   if (uiProbePort == uiResetPort) { //its reset isn't over yet
+      return;
+   }
+
+   uint8_t ucVer = rfidReaderProbe(uiProbePort);
+   if (ucVer != 0) {
+      rfidReaderConfig(uiProbePort);
+      if (readerHealthy(uiProbePort, ucVer)) { //a failed reader must keep its configuration
+         readerActivate(uiProbePort, ucVer);
+      }
+   }
+}
+
+void printBoardInfo(void){
+   Serial.println(F("************************************************"));
+   for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+      if (rfidPorts[i].bActive) {
+         Serial.print(F("Reader "));
+         Serial.print(i + 1);
+         Serial.print(F(" present; version = "));
+         Serial.println(svRead(SV_ADDR_USER_BASE + SV_CFG_RDR_VER + i), HEX);
+         printSensorData(i);
+      }
+   }
+   Serial.print(F("Nr. of active RFID readers: "));
+   Serial.println(uiActReaders);
+   Serial.println(F("************************************************"));
+}
+
+/*
+ * Return the next active reader after port (round robin over the active readers).
+ * At least one reader must be active
+ */
+uint8_t nextReader(uint8_t port){
+   do {
+      port++;
+      if (port >= NR_OF_RFID_PORTS) {
+         port = uiFirstReaderIdx;
+      }
+   } while (!rfidPorts[port].bActive);
+
+   return port;
+}
+
+void varInit(void){
+   for(uint8_t i = 0; i < NR_OF_RFID_PORTS; i++){
+     for(uint8_t j = 0; j < UID_LEN; j++){
+       rfidPorts[i].oldUid[j] = 0;
+     }
+     rfidPorts[i].presState = PRES_FREE;
+#if MULTI_TAG_MODE
+     memset(rfidPorts[i].knownUid, 0, sizeof(rfidPorts[i].knownUid));
+     rfidPorts[i].knownNext = 0;
+#endif
+     rfidPorts[i].bActive = false;
+     rfidPorts[i].bFailed = false;
+#if UID_TABLE
+     rfidPorts[i].locoAddr = 0;
+#endif
+#if USE_INTERRUPTS
+     rfidPorts[i].bNewInt = false;
+#endif
+   }  
+   for (uint8_t k = 0; k < SPEED_PAIRS; k++) {
+     for (uint8_t j = 0; j < SPEED_OPEN_MAX; j++) {
+       speedPairs[k].open[j].port = LN_NO_PORT;
+     }
+   }
+}
+
+/*
+ * The runtime counters. The ring high water / overflows are kept in lnTxRing
+ */
+void statsReset(void){
+   memset(&stats, 0, sizeof(stats));
+   lnTxRing.highWater = 0;
+   lnTxRing.overflows = 0;
+}
+
+/* called from every loop() pass*/
+void statsLoop(void){
+   static uint16_t uiLoops = 0;
+   static uint32_t ulSecStart = 0;
+
+   uiLoops++;
+   if ((millis() - ulSecStart) >= 1000) {
+      stats.loopsPerSec = uiLoops;
+      uiLoops = 0;
+      ulSecStart = millis();
+   }
+}
+
+uint8_t statsRead(uint8_t idx){
+   stats.ringHighWater = lnTxRing.highWater;
+   stats.ringOverflows = lnTxRing.overflows;
+   return ((uint8_t *)&stats)[idx];
+}
+
+#if PERF_MEASURE
+/*
+ * Print the performance data of the last measurement window on Serial and start a new window.
+ * Called from every loop() pass; does nothing until PERF_REPORT_PERIOD is elapsed.
+ */
+void perfReport(void){
+   uint32_t ulElapsed = millis() - perfData.windowStart;
+
+   if (ulElapsed < PERF_REPORT_PERIOD) {
+      return;
+   }
+
+   if (bSerialOk) {
+      Serial.print(F("Loops/s: "));
+      Serial.print((perfData.loopCnt * 1000UL) / ulElapsed);
+      Serial.print(F(" Rdr calls/loop: "));
+      Serial.print(perfData.loopCnt ? (perfData.rdrCalls / perfData.loopCnt) : 0);
+      Serial.print(F(" Tags sent: "));
+      Serial.print(perfData.latCnt);
+      if (perfData.latCnt > 0) {
+         Serial.print(F(" Latency avg/max (us): "));
+         Serial.print(perfData.latSum / perfData.latCnt);
+         Serial.print(F(" / "));
+         Serial.print(perfData.latMax);
+      }
+      Serial.println();
+      Serial.print(F(" Ring high water/overflows: "));
+      Serial.print(lnTxRing.highWater);
+      Serial.print(F(" / "));
+      Serial.print(lnTxRing.overflows);
+      Serial.print(F(" EEPROM writes: "));
+      Serial.print(stats.eeWrites);
+      Serial.print(F(" LN send status:"));
+      for (uint8_t i = 0; i <= LN_RETRY_ERROR; i++) {
+         Serial.print(' ');
+         Serial.print(stats.sendStatus[i]);
+      }
+      Serial.println();
+      for (uint8_t i = 0; i < NR_OF_RFID_PORTS; i++) {
+         if (rfidPorts[i].bActive) {
+            Serial.print(F(" Reader "));
+            Serial.print(i + 1);
+            Serial.print(F(" tags/resets: "));
+            Serial.print(stats.reader[i].detections);
+            Serial.print(F(" / "));
+            Serial.print(stats.reader[i].resets);
+            Serial.print(F(" SPI trans/bytes: "));
+            Serial.print(rfidPorts[i].spiTrans);
+            Serial.print(F(" / "));
+            Serial.println(rfidPorts[i].spiBytes);
+         }
+      }
+   }
+
+   perfData.windowStart = millis();
+   perfData.loopCnt = 0;
+   perfData.rdrCalls = 0;
+   perfData.latSum = 0;
+   perfData.latMax = 0;
+   perfData.latCnt = 0;
+}
+#endif